@@ -0,0 +1,176 @@
+#include "allocationGuard.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <execinfo.h>
+#include <unistd.h>
+
+
+namespace
+{
+  constexpr int kMaxBacktraceDepth = 32;
+
+  std::atomic<std::size_t> gTotalAllocations{ 0 };
+  std::atomic<std::size_t> gSteadyStateAllocations{ 0 };
+  std::atomic<bool> gSteadyState{ false };
+  std::atomic<bool> gFailOnAllocation{ false };
+  thread_local bool tTracked = false;
+  thread_local int tExemptions = 0;
+
+#ifdef RPICLIENT_FIXED_MEMORY
+  void ReportAndAbort() {
+    // Runs inside operator new, nothing here may allocate, Boost.Log included.
+    static const char kMessage[] = "Heap allocation in steady state, backtrace:\n";
+    if (write(STDERR_FILENO, kMessage, sizeof(kMessage) - 1) < 0) {
+      std::abort();
+    }
+    void* frames[kMaxBacktraceDepth];
+    backtrace_symbols_fd(frames, backtrace(frames, kMaxBacktraceDepth), STDERR_FILENO);
+    std::abort();
+  }
+
+  void CountAllocation() {
+    gTotalAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (!tTracked || tExemptions > 0 || !gSteadyState.load(std::memory_order_relaxed)) {
+      return;
+    }
+    gSteadyStateAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (gFailOnAllocation.load(std::memory_order_relaxed)) {
+      ReportAndAbort();
+    }
+  }
+
+  void* Allocate(std::size_t size) {
+    CountAllocation();
+    if (void* pointer = std::malloc(size ? size : 1)) {
+      return pointer;
+    }
+    throw std::bad_alloc();
+  }
+
+  void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+    CountAllocation();
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, static_cast<std::size_t>(alignment), size ? size : 1) != 0) {
+      throw std::bad_alloc();
+    }
+    return pointer;
+  }
+#endif
+}
+
+namespace AllocationGuard {
+
+bool IsEnabled() {
+#ifdef RPICLIENT_FIXED_MEMORY
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TrackCurrentThread() {
+  tTracked = true;
+}
+
+void EnterSteadyState(bool failOnAllocation) {
+  if (failOnAllocation) {
+    // The first backtrace() loads libgcc and allocates, do it now rather than while reporting.
+    void* frames[1];
+    backtrace(frames, 1);
+  }
+  gFailOnAllocation = failOnAllocation;
+  gSteadyState = true;
+}
+
+void LeaveSteadyState() {
+  gSteadyState = false;
+}
+
+std::size_t GetTotalAllocations() {
+  return gTotalAllocations;
+}
+
+std::size_t GetSteadyStateAllocations() {
+  return gSteadyStateAllocations;
+}
+
+ScopedExemption::ScopedExemption() {
+  ++tExemptions;
+}
+
+ScopedExemption::~ScopedExemption() {
+  --tExemptions;
+}
+
+}
+
+#ifdef RPICLIENT_FIXED_MEMORY
+void* operator new(std::size_t size) {
+  return Allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+  return Allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  CountAllocation();
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  CountAllocation();
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+#endif
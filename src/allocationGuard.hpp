@@ -0,0 +1,33 @@
+#ifndef ALLOCATION_GUARD_HPP
+#define ALLOCATION_GUARD_HPP
+
+#include <cstddef>
+
+// In RPICLIENT_FIXED_MEMORY builds the global operator new counts every heap allocation. Threads
+// running a steady state loop register themselves, and once the app declares steady state every
+// allocation on them is a violation: counted, or with failOnAllocation written to stderr with a
+// backtrace followed by abort(), so a replayed trace run in CI fails on the first allocation that
+// slips in. Memory taken straight from malloc by C libraries (zlib) is not seen.
+// Other builds keep the interface, but count nothing.
+namespace AllocationGuard {
+
+bool IsEnabled();
+void TrackCurrentThread();
+void EnterSteadyState(bool failOnAllocation);
+void LeaveSteadyState();
+std::size_t GetTotalAllocations();
+std::size_t GetSteadyStateAllocations();
+
+// Allocations on the current thread are not violations while it's alive, for code that only
+// stands in for hardware, like trace replay.
+class ScopedExemption {
+public:
+    ScopedExemption();
+    ~ScopedExemption();
+    ScopedExemption(const ScopedExemption&) = delete;
+    ScopedExemption& operator=(const ScopedExemption&) = delete;
+};
+
+}
+
+#endif // ALLOCATION_GUARD_HPP
@@ -0,0 +1,174 @@
+#ifndef AT_COMMANDS_HPP
+#define AT_COMMANDS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string_view>
+
+// Every AT command the client issues, with the reply it waits for, the replies that fail it, its
+// timeout and whether it may be sent again when the modem doesn't answer in time.
+//
+// The catalog is constexpr: reply tokens live in static tables and a command's printf template is
+// checked against its argument types when the catalog is compiled, so issuing a command formats it
+// into a stack buffer and allocates nothing.
+namespace AtCommands {
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t kMaxTokens = 4;
+// Longest formatted command, the CIPSTART host name is the variable part.
+constexpr std::size_t kMaxCommandSize = 128;
+constexpr std::chrono::milliseconds kDefaultTimeout = 2s;
+
+// Tokens that must all appear in order, each one after the end of the previous.
+class TokenSequence {
+public:
+    static constexpr std::size_t npos = std::string_view::npos;
+
+    template<typename... Tokens>
+    constexpr TokenSequence(Tokens... tokens) : tokens_{ std::string_view(tokens)... }, count_(sizeof...(Tokens)) {
+        static_assert(sizeof...(Tokens) <= kMaxTokens, "Too many reply tokens");
+    }
+
+    // Offset just past the last token, npos while the sequence is incomplete.
+    constexpr std::size_t Match(std::string_view text) const {
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < count_; ++i) {
+            auto found = text.find(tokens_[i], offset);
+            if (found == npos) {
+                return npos;
+            }
+            offset = found + tokens_[i].size();
+        }
+        return offset;
+    }
+
+    // True when any one of the tokens appears, for error replies.
+    constexpr bool MatchAny(std::string_view text) const {
+        for (std::size_t i = 0; i < count_; ++i) {
+            if (text.find(tokens_[i]) != npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::array<std::string_view, kMaxTokens> tokens_;
+    std::size_t count_;
+};
+
+struct Reply {
+    TokenSequence expected;
+    TokenSequence errors;
+    std::chrono::milliseconds timeout;
+    // Idempotent, sent once more if the modem stays silent until the timeout.
+    bool retryable;
+};
+
+// printf conversion each argument type has to be formatted with.
+template<typename T> struct Conversion;
+template<> struct Conversion<const char*> { static constexpr std::string_view kSpec = "s"; };
+template<> struct Conversion<std::size_t> { static constexpr std::string_view kSpec = "zu"; };
+template<> struct Conversion<int> { static constexpr std::string_view kSpec = "d"; };
+
+template<typename... Args>
+constexpr bool FormatMatches(std::string_view format) {
+    constexpr std::array<std::string_view, sizeof...(Args)> specs{ Conversion<Args>::kSpec... };
+    std::size_t arg = 0;
+    for (std::size_t i = 0; i < format.size(); ++i) {
+        if (format[i] != '%') {
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            ++i;
+            continue;
+        }
+        if (arg == specs.size() || format.substr(i + 1, specs[arg].size()) != specs[arg]) {
+            return false;
+        }
+        i += specs[arg++].size();
+    }
+    return arg == specs.size();
+}
+
+template<typename... Args>
+class Command {
+public:
+    constexpr Command(const char* format, Reply reply) : format_(format), reply_(reply) {
+        // Not a constant expression when the template doesn't fit Args, so a bad entry fails to compile.
+        if (!FormatMatches<Args...>(format)) {
+            throw std::logic_error("AT command template doesn't match its arguments");
+        }
+    }
+
+    constexpr const Reply& GetReply() const {
+        return reply_;
+    }
+
+    // Formatted size, 0 when the command doesn't fit.
+    std::size_t Format(std::array<char, kMaxCommandSize>& buffer, Args... args) const {
+        int size = 0;
+        if constexpr (sizeof...(Args) == 0) {
+            size = std::snprintf(buffer.data(), buffer.size(), "%s", format_);
+        }
+        else {
+            size = std::snprintf(buffer.data(), buffer.size(), format_, args...);
+        }
+        return size < 0 || static_cast<std::size_t>(size) >= buffer.size() ? 0 : static_cast<std::size_t>(size);
+    }
+
+private:
+    const char* format_;
+    Reply reply_;
+};
+
+// Arguments are taken exactly as the catalog declares them, not deduced from the call.
+template<typename T>
+struct Argument {
+    using Type = T;
+};
+template<typename T>
+using ArgumentType = typename Argument<T>::Type;
+
+constexpr TokenSequence kErrors{ "ERROR" };
+constexpr TokenSequence kOk{ "OK" };
+
+constexpr Command<> kAt{ "AT\r\n", { kOk, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kFullFunctionality{ "AT+CFUN=1\r\n", { kOk, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kSimStatus{ "AT+CPIN?\r\n", { { "+CPIN: READY" }, kErrors, kDefaultTimeout, true } };
+constexpr Command<int> kSlowClock{ "AT+CSCLK=%d\r\n", { kOk, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kSignalQuality{ "AT+CSQ\r\n", { { "+CSQ:", "OK" }, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kRegistrationStatus{ "AT+CREG?\r\n", { { "+CREG:", "OK" }, kErrors, kDefaultTimeout, true } };
+
+constexpr Command<const char*> kSetApn{ "AT+CSTT=\"%s\",\"\",\"\"\r\n", { kOk, kErrors, kDefaultTimeout, false } };
+constexpr Command<> kBringUpWireless{ "AT+CIICR\r\n", { kOk, kErrors, kDefaultTimeout, false } };
+constexpr Command<> kGetIpAddress{ "AT+CIFSR\r\n", { { ".", ".", ".", "\n" }, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kShowIpHeader{ "AT+CIPHEAD=1\r\n", { kOk, kErrors, kDefaultTimeout, true } };
+// Connection type, address, port.
+constexpr Command<const char*, const char*, std::size_t> kStartConnection{ "AT+CIPSTART=\"%s\",\"%s\",%zu\r\n",
+    { { "OK", "CONNECT OK" }, { "ERROR", "CONNECT FAIL" }, 6s, false } };
+constexpr Command<std::size_t> kSendPrompt{ "AT+CIPSEND=%zu\r\n", { { ">" }, kErrors, kDefaultTimeout, false } };
+// Reply to the payload written after the send prompt.
+constexpr Reply kSendPayload{ { "SEND OK" }, { "ERROR", "SEND FAIL" }, kDefaultTimeout, false };
+// Largest payload a single CIPSEND takes, "+CIPSEND: <size>".
+constexpr Command<> kSendBufferSize{ "AT+CIPSEND?\r\n", { { "+CIPSEND:", "OK" }, kErrors, kDefaultTimeout, true } };
+// 1 - a payload is answered once it is in the modem's buffer, acknowledgements are polled with CIPACK.
+constexpr Command<int> kQuickSend{ "AT+CIPQSEND=%d\r\n", { kOk, kErrors, kDefaultTimeout, true } };
+// Reply to the payload in quick send mode, "DATA ACCEPT:<length>".
+constexpr Reply kQuickSendPayload{ { "DATA ACCEPT:", "\n" }, { "ERROR", "SEND FAIL" }, kDefaultTimeout, false };
+// Bytes sent, acknowledged and unacknowledged on the connection, "+CIPACK: <txlen>,<acklen>,<nacklen>".
+constexpr Command<> kAcknowledged{ "AT+CIPACK\r\n", { { "+CIPACK:", "OK" }, kErrors, kDefaultTimeout, true } };
+constexpr Command<> kCloseConnection{ "AT+CIPCLOSE\r\n", { { "CLOSE OK" }, kErrors, 6s, false } };
+constexpr Command<> kShutConnection{ "AT+CIPSHUT\r\n", { { "OK", "SHUT OK" }, kErrors, 6s, true } };
+
+// Unsolicited data, "+IPD,<length>:<data>" with AT+CIPHEAD=1.
+constexpr TokenSequence kIncomingDataHeader{ "+IPD,", ":" };
+constexpr TokenSequence kConnectionClosed{ "CLOSED" };
+
+}
+
+#endif // AT_COMMANDS_HPP
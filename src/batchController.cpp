@@ -0,0 +1,140 @@
+#include "batchController.hpp"
+
+#include <algorithm>
+
+
+BatchController::BatchController() : BatchController(Config()) {}
+
+BatchController::BatchController(const Config& config) : config_(config) {
+  metrics_.batchSize = std::clamp(config_.initialBatchSize, config_.minBatchSize, config_.maxBatchSize);
+  metrics_.flushInterval = config_.minFlushInterval;
+}
+
+BatchController::Decision BatchController::OnSendCompleted(std::size_t bytes, std::chrono::milliseconds latency, bool success) {
+  ++metrics_.sends;
+  if (!success) {
+    ++metrics_.failures;
+    return Apply(Decision::SHRINK);
+  }
+  double latencyMs = latency.count();
+  bool spike = weight_ > 0.0 && latencyMs > config_.latencySpikeFactor * ExpectedLatencyMs(bytes);
+  FitLatency(bytes, latencyMs);
+  auto goodput = latencyMs > 0.0 ? bytes * 1000.0 / latencyMs : 0.0;
+  metrics_.goodputBps += config_.smoothing * (goodput - metrics_.goodputBps);
+  if (spike) {
+    return Apply(Decision::SHRINK);
+  }
+  if (metrics_.rssi < config_.poorRssi || !metrics_.registered) {
+    return Apply(Decision::HOLD);
+  }
+  auto expected = ExpectedLatencyMs(metrics_.batchSize);
+  if (expected > 0.0 && metrics_.fixedLatencyMs / expected > config_.overheadDominates) {
+    return Apply(Decision::GROW);
+  }
+  return Apply(Decision::HOLD);
+}
+
+BatchController::Decision BatchController::OnLinkQuality(int rssi, bool registered) {
+  // 99 means the modem couldn't measure it, keep the last known value.
+  if (rssi != 99) {
+    metrics_.rssi = rssi;
+  }
+  metrics_.registered = registered;
+  if (metrics_.rssi < config_.poorRssi || !registered) {
+    return Apply(Decision::SHRINK);
+  }
+  return Apply(Decision::HOLD);
+}
+
+void BatchController::OnDataQueued(std::size_t bytes, Clock::time_point now) {
+  if (!arrivalStarted_) {
+    arrivalStarted_ = true;
+    lastArrival_ = now;
+    return;
+  }
+  // Frames drained together share a timestamp, their bytes count once time has moved on.
+  pendingArrivalBytes_ += bytes;
+  auto elapsed = std::chrono::duration<double>(now - lastArrival_).count();
+  if (elapsed <= 0.0) {
+    return;
+  }
+  metrics_.arrivalBps += config_.smoothing * (pendingArrivalBytes_ / elapsed - metrics_.arrivalBps);
+  pendingArrivalBytes_ = 0;
+  lastArrival_ = now;
+  UpdateFlushInterval();
+}
+
+std::size_t BatchController::GetBatchSize() const {
+  return metrics_.batchSize;
+}
+
+std::chrono::milliseconds BatchController::GetFlushInterval() const {
+  return metrics_.flushInterval;
+}
+
+const BatchController::Metrics& BatchController::GetMetrics() const {
+  return metrics_;
+}
+
+const char* BatchController::DecisionToString(Decision decision) {
+  switch (decision) {
+  case Decision::HOLD:
+    return "hold";
+  case Decision::GROW:
+    return "grow";
+  case Decision::SHRINK:
+    return "shrink";
+  }
+  return "";
+}
+
+void BatchController::FitLatency(double bytes, double latencyMs) {
+  auto decay = 1.0 - config_.smoothing;
+  weight_ = weight_ * decay + 1.0;
+  sumX_ = sumX_ * decay + bytes;
+  sumY_ = sumY_ * decay + latencyMs;
+  sumXX_ = sumXX_ * decay + bytes * bytes;
+  sumXY_ = sumXY_ * decay + bytes * latencyMs;
+
+  auto denominator = weight_ * sumXX_ - sumX_ * sumX_;
+  // Without enough spread in batch sizes the slope is unknown, treat all latency as fixed cost.
+  double perByte = 0.0;
+  if (denominator > 1e-6 * weight_ * sumXX_) {
+    perByte = std::max(0.0, (weight_ * sumXY_ - sumX_ * sumY_) / denominator);
+  }
+  metrics_.perByteMs = perByte;
+  metrics_.fixedLatencyMs = std::max(0.0, (sumY_ - perByte * sumX_) / weight_);
+}
+
+double BatchController::ExpectedLatencyMs(double bytes) const {
+  return metrics_.fixedLatencyMs + metrics_.perByteMs * bytes;
+}
+
+BatchController::Decision BatchController::Apply(Decision decision) {
+  auto previousBatchSize = metrics_.batchSize;
+  switch (decision) {
+  case Decision::GROW:
+    metrics_.batchSize = std::min(config_.maxBatchSize, metrics_.batchSize + metrics_.batchSize / 2);
+    break;
+  case Decision::SHRINK:
+    metrics_.batchSize = std::max(config_.minBatchSize, metrics_.batchSize / 2);
+    break;
+  case Decision::HOLD:
+    break;
+  }
+  // Hitting a limit is no change, report it as such.
+  if (metrics_.batchSize == previousBatchSize) {
+    decision = Decision::HOLD;
+  }
+  metrics_.lastDecision = decision;
+  UpdateFlushInterval();
+  return decision;
+}
+
+void BatchController::UpdateFlushInterval() {
+  if (metrics_.arrivalBps <= 0.0) {
+    return;
+  }
+  std::chrono::milliseconds interval(static_cast<long>(metrics_.batchSize * 1000.0 / metrics_.arrivalBps));
+  metrics_.flushInterval = std::clamp(interval, config_.minFlushInterval, config_.maxFlushInterval);
+}
@@ -0,0 +1,87 @@
+#ifndef BATCH_CONTROLLER_HPP
+#define BATCH_CONTROLLER_HPP
+
+#include <chrono>
+#include <cstddef>
+
+// Picks the uplink batch size and flush interval from what the link actually does.
+//
+// SEND OK latency is modelled as fixed + perByte * bytes, fitted over recent sends.
+// While the fixed (round trip) part dominates, batches grow; failures, latency spikes
+// and poor signal shrink them. The flush interval follows so that a batch fills up
+// at the measured data arrival rate.
+//
+// The controller does no I/O and takes time as a parameter, so it can be driven by
+// a simulated link.
+class BatchController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        std::size_t minBatchSize = 128;
+        std::size_t maxBatchSize = 1024;
+        std::size_t initialBatchSize = 256;
+        std::chrono::milliseconds minFlushInterval{ 1000 };
+        std::chrono::milliseconds maxFlushInterval{ 60000 };
+        // CSQ rssi below this is treated as a lossy link.
+        int poorRssi = 10;
+        double overheadDominates = 0.5;
+        double latencySpikeFactor = 3.0;
+        double smoothing = 0.2;
+    };
+
+    enum class Decision {
+        HOLD,
+        GROW,
+        SHRINK,
+    };
+
+    struct Metrics {
+        std::size_t batchSize = 0;
+        std::chrono::milliseconds flushInterval{ 0 };
+        double goodputBps = 0.0;
+        double fixedLatencyMs = 0.0;
+        double perByteMs = 0.0;
+        double arrivalBps = 0.0;
+        int rssi = 99;
+        bool registered = true;
+        std::size_t sends = 0;
+        std::size_t failures = 0;
+        Decision lastDecision = Decision::HOLD;
+    };
+
+    BatchController();
+    explicit BatchController(const Config& config);
+
+    Decision OnSendCompleted(std::size_t bytes, std::chrono::milliseconds latency, bool success);
+    Decision OnLinkQuality(int rssi, bool registered);
+    void OnDataQueued(std::size_t bytes, Clock::time_point now);
+
+    std::size_t GetBatchSize() const;
+    std::chrono::milliseconds GetFlushInterval() const;
+    const Metrics& GetMetrics() const;
+
+    static const char* DecisionToString(Decision decision);
+
+private:
+    void FitLatency(double bytes, double latencyMs);
+    double ExpectedLatencyMs(double bytes) const;
+    Decision Apply(Decision decision);
+    void UpdateFlushInterval();
+
+private:
+    Config config_;
+    Metrics metrics_;
+    // Exponentially weighted sums for the least squares fit of latency over bytes.
+    double weight_ = 0.0;
+    double sumX_ = 0.0;
+    double sumY_ = 0.0;
+    double sumXX_ = 0.0;
+    double sumXY_ = 0.0;
+    bool arrivalStarted_ = false;
+    Clock::time_point lastArrival_;
+    // Queued since lastArrival_, not yet part of the arrival rate.
+    std::size_t pendingArrivalBytes_ = 0;
+};
+
+#endif // BATCH_CONTROLLER_HPP
@@ -51,8 +51,10 @@ bool Bme280::Init() {
   i2cFd_.reset(fd);
 
   ReadCalibrationData();
-  wiringPiI2CWriteReg8(i2cFd_.get(), 0xf2, 0x01);   // humidity oversampling x 1
-  wiringPiI2CWriteReg8(i2cFd_.get(), 0xf4, 0x25);
+  wiringPiI2CWriteReg8(i2cFd_.get(), BME280_REGISTER_CONTROLHUMID, 0x01);   // humidity oversampling x 1
+  wiringPiI2CWriteReg8(i2cFd_.get(), BME280_REGISTER_CONFIG, 0x00);         // 0.5 ms standby, IIR filter off
+  // Normal mode with x 1 oversampling converts continuously, so the sampler can run at max ODR
+  wiringPiI2CWriteReg8(i2cFd_.get(), BME280_REGISTER_CONTROL, 0x27);
 
   return true;
 
@@ -0,0 +1,87 @@
+#ifndef CIC_DECIMATOR_HPP
+#define CIC_DECIMATOR_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Cascaded integrator-comb decimator for a fixed number of channels.
+//
+// Inputs are converted to fixed point and run through `order` integrators at the
+// input rate and `order` combs at the output rate. Integrators wrap around on purpose,
+// CIC arithmetic is exact modulo 2^64 as long as the result fits. No allocation, so it
+// is safe to use next to the sampling loop.
+template<std::size_t Channels>
+class CicDecimator {
+public:
+    static constexpr std::size_t kMaxOrder = 5;
+    using Values = std::array<double, Channels>;
+
+    CicDecimator(std::size_t factor = 1, std::size_t order = 3, double scale = 1000.0) {
+        Reset(factor, order, scale);
+    }
+
+    void Reset(std::size_t factor, std::size_t order, double scale = 1000.0) {
+        factor_ = factor < 1 ? 1 : factor;
+        order_ = order < 1 ? 1 : (order > kMaxOrder ? kMaxOrder : order);
+        scale_ = scale;
+        gain_ = std::pow(static_cast<double>(factor_), static_cast<double>(order_)) * scale_;
+        phase_ = 0;
+        outputs_ = 0;
+        integrators_ = {};
+        combs_ = {};
+    }
+
+    // Whether inputs up to maxInput in magnitude keep the output within the signed 64 bit
+    // integrators. Each stage grows it by log2(factor) bits, past 63 the output wraps.
+    static bool Fits(std::size_t factor, std::size_t order, double maxInput, double scale = 1000.0) {
+        factor = factor < 1 ? 1 : factor;
+        order = order < 1 ? 1 : (order > kMaxOrder ? kMaxOrder : order);
+        return order * std::log2(static_cast<double>(factor)) + std::log2(maxInput * scale) < 63.0;
+    }
+
+    std::size_t GetFactor() const {
+        return factor_;
+    }
+
+    // Returns true when in completes a decimated output in out. The first order - 1 outputs
+    // are still ramping up and are swallowed.
+    bool Push(const Values& in, Values& out) {
+        for (std::size_t channel = 0; channel < Channels; ++channel) {
+            auto value = static_cast<uint64_t>(static_cast<int64_t>(std::llround(in[channel] * scale_)));
+            auto& integrators = integrators_[channel];
+            for (std::size_t stage = 0; stage < order_; ++stage) {
+                integrators[stage] += value;
+                value = integrators[stage];
+            }
+        }
+        if (++phase_ < factor_) {
+            return false;
+        }
+        phase_ = 0;
+        for (std::size_t channel = 0; channel < Channels; ++channel) {
+            auto value = integrators_[channel][order_ - 1];
+            auto& combs = combs_[channel];
+            for (std::size_t stage = 0; stage < order_; ++stage) {
+                auto delayed = combs[stage];
+                combs[stage] = value;
+                value -= delayed;
+            }
+            out[channel] = static_cast<double>(static_cast<int64_t>(value)) / gain_;
+        }
+        return ++outputs_ >= order_;
+    }
+
+private:
+    std::size_t factor_ = 1;
+    std::size_t order_ = 1;
+    double scale_ = 1.0;
+    double gain_ = 1.0;
+    std::size_t phase_ = 0;
+    std::size_t outputs_ = 0;
+    std::array<std::array<uint64_t, kMaxOrder>, Channels> integrators_{};
+    std::array<std::array<uint64_t, kMaxOrder>, Channels> combs_{};
+};
+
+#endif // CIC_DECIMATOR_HPP
@@ -0,0 +1,59 @@
+#include "clientProtocol.hpp"
+
+
+namespace
+{
+  constexpr const char kOKReply[] = "OK";
+}
+
+namespace ClientProtocol {
+
+std::string ClientTypeToString(ClientType clientType) {
+  if (clientType == ClientType::PUBLISHER) return "PUBLISHER";
+  return "SUBSCRIBER";
+}
+
+ClientType DeduceClientType(const std::string& ct) {
+  if (ct == "PUBLISHER") return ClientType::PUBLISHER;
+  return ClientType::SUBSCRIBER;
+}
+
+std::string BuildHandshake(ClientType clientType, TelemetryCodec::Type offeredCodec) {
+  std::string data = "{\"ClientType\":\"" + ClientTypeToString(clientType) + "\"";
+  if (offeredCodec != TelemetryCodec::Type::NONE) {
+    data += ",\"Codecs\":[\"" + TelemetryCodec::TypeToString(offeredCodec) + "\"]";
+  }
+  data += "}";
+  return data;
+}
+
+bool ParseHandshakeReply(const std::string& reply, TelemetryCodec::Type offeredCodec, TelemetryCodec::Type& negotiated) {
+  if (reply.find(kOKReply) == std::string::npos) {
+    return false;
+  }
+  negotiated = TelemetryCodec::Type::NONE;
+  if (offeredCodec != TelemetryCodec::Type::NONE && reply.find(TelemetryCodec::TypeToString(offeredCodec)) != std::string::npos) {
+    negotiated = offeredCodec;
+  }
+  return true;
+}
+
+std::size_t HandshakeReplySize(const std::string& reply, TelemetryCodec::Type negotiated) {
+  auto end = reply.find(kOKReply);
+  if (end == std::string::npos) {
+    return 0;
+  }
+  end += sizeof(kOKReply) - 1;
+  if (negotiated != TelemetryCodec::Type::NONE) {
+    auto codec = " " + TelemetryCodec::TypeToString(negotiated);
+    if (reply.compare(end, codec.size(), codec) == 0) {
+      end += codec.size();
+    }
+  }
+  if (reply.compare(end, 2, "\r\n") == 0) {
+    return end + 2;
+  }
+  return reply.compare(end, 1, "\n") == 0 ? end + 1 : end;
+}
+
+}
@@ -0,0 +1,33 @@
+#ifndef CLIENT_PROTOCOL_HPP
+#define CLIENT_PROTOCOL_HPP
+
+#include <string>
+
+#include "telemetryCodec.hpp"
+
+// Client side of the server protocol, shared by everything that talks to the server.
+//
+// After connecting the client sends {"ClientType":"PUBLISHER"|"SUBSCRIBER","Codecs":["<codec>"]}
+// (Codecs is left out when no codec is offered). The server replies "OK", followed by the codec
+// name when it accepts the offered codec, a plain "OK" keeps frames uncompressed. Everything
+// after the handshake is the frame stream.
+namespace ClientProtocol {
+
+enum class ClientType : bool {
+    PUBLISHER = 0,
+    SUBSCRIBER = 1,
+};
+
+std::string ClientTypeToString(ClientType clientType);
+ClientType DeduceClientType(const std::string& ct);
+
+std::string BuildHandshake(ClientType clientType, TelemetryCodec::Type offeredCodec);
+// False when the server refused the client, negotiated is the codec the frames use from now on.
+bool ParseHandshakeReply(const std::string& reply, TelemetryCodec::Type offeredCodec, TelemetryCodec::Type& negotiated);
+// Length of the reply line with its terminator, if any. Frames relayed right behind it arrive in the
+// same chunk.
+std::size_t HandshakeReplySize(const std::string& reply, TelemetryCodec::Type negotiated);
+
+}
+
+#endif // CLIENT_PROTOCOL_HPP
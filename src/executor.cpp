@@ -0,0 +1,57 @@
+#include "executor.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <pthread.h>
+
+
+Executor::Executor(const std::string& name, std::size_t threads, std::vector<int> cpus) : name_(name),
+threadCount_(threads), cpus_(std::move(cpus)) {}
+
+Executor::~Executor() {
+  Stop();
+}
+
+boost::asio::io_service& Executor::GetIoService() {
+  return ioService_;
+}
+
+void Executor::Start() {
+  work_ = std::make_unique<boost::asio::io_service::work>(ioService_);
+  for (std::size_t i = 0; i < threadCount_; ++i) {
+    int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+    threads_.emplace_back([this, cpu, i]() {
+      pthread_setname_np(pthread_self(), (threadCount_ == 1 ? name_ : name_ + std::to_string(i)).substr(0, 15).c_str());
+      PinCurrentThread(cpu);
+      ioService_.run();
+      });
+  }
+}
+
+void Executor::Stop() {
+  work_.reset();
+  ioService_.stop();
+  for (auto& thread : threads_) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      thread.detach();
+    }
+    else if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  threads_.clear();
+}
+
+bool Executor::PinCurrentThread(int cpu) {
+  if (cpu < 0) {
+    return true;
+  }
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to pin thread to cpu " << cpu;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,35 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+// io_service driven by its own threads, optionally pinned to CPUs.
+class Executor {
+public:
+    Executor(const std::string& name, std::size_t threads = 1, std::vector<int> cpus = {});
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    boost::asio::io_service& GetIoService();
+    void Start();
+    void Stop();
+
+    // Pins calling thread to cpu, negative cpu leaves the affinity untouched.
+    static bool PinCurrentThread(int cpu);
+
+private:
+    std::string name_;
+    std::size_t threadCount_;
+    std::vector<int> cpus_;
+    boost::asio::io_service ioService_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::vector<std::thread> threads_;
+};
+
+#endif // EXECUTOR_HPP
@@ -1,10 +1,63 @@
 #include "extendedSerialPort.hpp"
 
-ExtendedSerialPort::ExtendedSerialPort(boost::asio::io_service& ioService) : boost::asio::serial_port(ioService) {}
+ExtendedSerialPort::ExtendedSerialPort(boost::asio::io_service& ioService) : boost::asio::serial_port(ioService), ioService_(ioService) {}
 
 bool ExtendedSerialPort::IsDataAvailable()
 {
+    if (replay_) {
+        return replay_->IsDataAvailable();
+    }
     int value = 0;
     ::ioctl(native_handle(), FIONREAD, &value);
     return value != 0;
-}
\ No newline at end of file
+}
+
+void ExtendedSerialPort::cancel()
+{
+    if (replay_) {
+        replay_->Cancel();
+        return;
+    }
+    boost::system::error_code ec;
+    boost::asio::serial_port::cancel(ec);
+}
+
+bool ExtendedSerialPort::StartRecording(const std::string& path)
+{
+    auto recorder = std::make_unique<SerialTrace::Writer>();
+    if (!recorder->Open(path)) {
+        return false;
+    }
+    recorder_ = std::move(recorder);
+    return true;
+}
+
+bool ExtendedSerialPort::StartReplay(const std::string& path, bool asFastAsPossible, std::function<void()> onFinished)
+{
+    auto replay = std::make_unique<SerialTrace::Replay>(ioService_, asFastAsPossible, std::move(onFinished));
+    if (!replay->Load(path)) {
+        return false;
+    }
+    replay_ = std::move(replay);
+    return true;
+}
+
+bool ExtendedSerialPort::IsReplaying() const
+{
+    return replay_ != nullptr;
+}
+
+bool ExtendedSerialPort::IsReplayFinished() const
+{
+    return replay_ && replay_->IsFinished();
+}
+
+std::size_t ExtendedSerialPort::GetReplayMismatches() const
+{
+    return replay_ ? replay_->GetMismatches() : 0;
+}
+
+boost::asio::io_service& ExtendedSerialPort::get_io_service()
+{
+    return ioService_;
+}
@@ -1,15 +1,99 @@
 #ifndef EXTENDED_SERIAL_PORT_HPP
 #define EXTENDED_SERIAL_PORT_HPP
 
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include <boost/asio/associated_allocator.hpp>
 #include <boost/asio/serial_port.hpp>
 #include <boost/asio/io_service.hpp>
 
+#include "allocationGuard.hpp"
+#include "serialTrace.hpp"
+
+// Serial port with an optional traffic recorder, or a trace replay standing in for the modem.
+// Sim800 only uses write_some, async_read_some and cancel, which are shadowed here to add the tap.
+// The replay is not part of the app, its allocations are exempt from the steady state check.
 class ExtendedSerialPort : public boost::asio::serial_port
 {
 public:
   ExtendedSerialPort(boost::asio::io_service& ioService);
   bool IsDataAvailable();
+  // Aborts the pending read, shadowed like the reads themselves so a replay is cancelled too.
+  void cancel();
+  bool StartRecording(const std::string& path);
+  // onFinished is posted once the app went past the end of the trace.
+  bool StartReplay(const std::string& path, bool asFastAsPossible, std::function<void()> onFinished = nullptr);
+  bool IsReplaying() const;
+  bool IsReplayFinished() const;
+  // Writes that didn't match the trace so far.
+  std::size_t GetReplayMismatches() const;
+  boost::asio::io_service& get_io_service();
+
+  template<typename ConstBufferSequence>
+  std::size_t write_some(const ConstBufferSequence& buffers) {
+    const boost::asio::const_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+    if (replay_) {
+      AllocationGuard::ScopedExemption exemption;
+      return replay_->Write(buffer.data(), buffer.size());
+    }
+    auto written = boost::asio::serial_port::write_some(buffers);
+    if (recorder_) {
+      recorder_->Record(SerialTrace::Direction::TX, buffer.data(), written);
+    }
+    return written;
+  }
+
+  template<typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler) {
+    const boost::asio::mutable_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+    if (replay_) {
+      AllocationGuard::ScopedExemption exemption;
+      replay_->AsyncRead(buffer, std::forward<ReadHandler>(handler));
+      return;
+    }
+    if (!recorder_) {
+      boost::asio::serial_port::async_read_some(buffers, std::forward<ReadHandler>(handler));
+      return;
+    }
+    using Handler = typename std::decay<ReadHandler>::type;
+    boost::asio::serial_port::async_read_some(buffers,
+      RecordingHandler<Handler>(*recorder_, buffer, std::forward<ReadHandler>(handler)));
+  }
+
+private:
+  // Records what a read delivered before handing it on. asio allocates the read operation through
+  // the handler's allocator, so it is passed on too: Sim800 reads into pooled memory.
+  template<typename Handler>
+  class RecordingHandler {
+  public:
+    using allocator_type = boost::asio::associated_allocator_t<Handler>;
+
+    template<typename H>
+    RecordingHandler(SerialTrace::Writer& recorder, boost::asio::mutable_buffer buffer, H&& handler)
+      : recorder_(&recorder), buffer_(buffer), handler_(std::forward<H>(handler)) {}
+
+    allocator_type get_allocator() const noexcept {
+      return boost::asio::get_associated_allocator(handler_);
+    }
+
+    void operator()(const boost::system::error_code& error, std::size_t readBytes) {
+      if (!error) {
+        recorder_->Record(SerialTrace::Direction::RX, buffer_.data(), readBytes);
+      }
+      handler_(error, readBytes);
+    }
+
+  private:
+    SerialTrace::Writer* recorder_;
+    boost::asio::mutable_buffer buffer_;
+    Handler handler_;
+  };
+
+  boost::asio::io_service& ioService_;
+  std::unique_ptr<SerialTrace::Writer> recorder_;
+  std::unique_ptr<SerialTrace::Replay> replay_;
 };
 
-#endif // EXTENDED_SERIAL_PORT_HPP
\ No newline at end of file
+#endif // EXTENDED_SERIAL_PORT_HPP
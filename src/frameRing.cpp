@@ -0,0 +1,63 @@
+#include "frameRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+FrameRing::FrameRing(std::size_t maxFrames, std::size_t arenaSize) :
+  arena_(std::max<std::size_t>(arenaSize, 1)),
+  slots_(std::max<std::size_t>(maxFrames, 1)) {}
+
+std::size_t FrameRing::Push(const char* data, std::size_t size, TimePoint queuedAt) {
+  if (size > arena_.size()) {
+    return 1;
+  }
+  std::size_t dropped = 0;
+  while (count_ == slots_.size() || bytes_ + size > arena_.size()) {
+    DropFront();
+    ++dropped;
+  }
+  // Frames wrap around the end of the arena, so a frame may be stored in two pieces.
+  auto firstPart = std::min(size, arena_.size() - writeOffset_);
+  std::memcpy(arena_.data() + writeOffset_, data, firstPart);
+  std::memcpy(arena_.data(), data + firstPart, size - firstPart);
+  slots_[(head_ + count_) % slots_.size()] = { writeOffset_, size, queuedAt };
+  writeOffset_ = (writeOffset_ + size) % arena_.size();
+  bytes_ += size;
+  ++count_;
+  return dropped;
+}
+
+void FrameRing::PopFront(std::vector<char>& out) {
+  const auto& slot = slots_[head_];
+  auto firstPart = std::min(slot.size, arena_.size() - slot.offset);
+  out.insert(out.end(), arena_.begin() + slot.offset, arena_.begin() + slot.offset + firstPart);
+  out.insert(out.end(), arena_.begin(), arena_.begin() + (slot.size - firstPart));
+  DropFront();
+}
+
+bool FrameRing::IsEmpty() const {
+  return count_ == 0;
+}
+
+std::size_t FrameRing::GetFrameCount() const {
+  return count_;
+}
+
+std::size_t FrameRing::GetBytes() const {
+  return bytes_;
+}
+
+std::size_t FrameRing::GetFrontSize() const {
+  return slots_[head_].size;
+}
+
+FrameRing::TimePoint FrameRing::GetFrontQueuedAt() const {
+  return slots_[head_].queuedAt;
+}
+
+void FrameRing::DropFront() {
+  bytes_ -= slots_[head_].size;
+  head_ = (head_ + 1) % slots_.size();
+  --count_;
+}
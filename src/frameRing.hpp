@@ -0,0 +1,47 @@
+#ifndef FRAME_RING_HPP
+#define FRAME_RING_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// FIFO of variable length frames for the publisher backlog. Frames are copied into one byte arena
+// and a table of frame slots, both allocated at construction, so queueing and dequeueing never
+// touch the heap. When either runs out the oldest frames make room.
+class FrameRing {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    FrameRing(std::size_t maxFrames, std::size_t arenaSize);
+
+    // Returns the number of oldest frames dropped to make room. A frame bigger than the arena
+    // is not queued and counts as dropped itself.
+    std::size_t Push(const char* data, std::size_t size, TimePoint queuedAt);
+    // Appends the oldest frame to out and removes it.
+    void PopFront(std::vector<char>& out);
+
+    bool IsEmpty() const;
+    std::size_t GetFrameCount() const;
+    std::size_t GetBytes() const;
+    std::size_t GetFrontSize() const;
+    TimePoint GetFrontQueuedAt() const;
+
+private:
+    struct Slot {
+        std::size_t offset;
+        std::size_t size;
+        TimePoint queuedAt;
+    };
+
+    void DropFront();
+
+private:
+    std::vector<char> arena_;
+    std::vector<Slot> slots_;
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    std::size_t writeOffset_ = 0;
+    std::size_t bytes_ = 0;
+};
+
+#endif // FRAME_RING_HPP
@@ -3,13 +3,23 @@
 #include <boost/log/trivial.hpp>
 #include <boost/bind.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <cstdlib>
 
 
 namespace
 {
-  constexpr const char kErrorReply[] = "ERROR";
+  // SIM800 limit for a single CIPSEND until AT+CIPSEND? tells the connection's own.
+  constexpr std::size_t kDefaultSegmentSize = 1460;
+  // Largest payload SendData takes without allocating, enough for a backlog drain batch.
+  constexpr std::size_t kSendBufferSize = 16 * 1024;
+  // Segments handed to the modem ahead of the peer's acknowledgements.
+  constexpr std::size_t kSegmentsInFlight = 4;
+  constexpr std::chrono::milliseconds kAckPollInterval{ 50 };
+  // Fails a segmented send when the peer acknowledges nothing for this long.
+  constexpr std::chrono::seconds kAckTimeout{ 10 };
+
   std::string ConnectionTypeToString(const Gprs::ConnectionType& ct) {
     switch (ct) {
     case Gprs::ConnectionType::TCP:
@@ -20,14 +30,29 @@ namespace
     return "";
   }
 
-  std::ostream& operator << (std::ostream& os, const Gprs::ConnectionType& obj) {
-    os << ConnectionTypeToString(obj);
-    return os;
+  // Value of the field at index in a "+TAG: a,b,..." reply.
+  std::experimental::optional<int> ParseReplyField(const std::string& reply, const std::string& tag, std::size_t index) {
+    auto offset = reply.find(tag);
+    if (offset == std::string::npos) {
+      return std::experimental::nullopt;
+    }
+    offset += tag.size();
+    for (std::size_t i = 0; i < index; ++i) {
+      offset = reply.find(',', offset);
+      if (offset == std::string::npos) {
+        return std::experimental::nullopt;
+      }
+      ++offset;
+    }
+    return std::atoi(reply.c_str() + offset);
   }
 }
 
 
-Gprs::Gprs(ExtendedSerialPort& serialPort) : Sim800(serialPort) {}
+Gprs::Gprs(ExtendedSerialPort& serialPort) : Sim800(serialPort),
+ackPollTimeout_(serialPort.get_io_service()) {
+  sendData_.reserve(kSendBufferSize);
+}
 
 void Gprs::Init(BoolResultCallback cb) {
   auto cfunCb = [=](OptionalString success) {
@@ -43,9 +68,9 @@ void Gprs::Init(BoolResultCallback cb) {
       this->PostCallbackWithArgs(cb, false);
       return;
     }
-    Execute("AT+CFUN=1\r\n", { {"OK"} }, cfunCb);
+    Execute(AtCommands::kFullFunctionality, cfunCb);
   };
-  Execute("AT\r\n", { {"OK"} }, atTestCb);
+  Execute(AtCommands::kAt, atTestCb);
 }
 
 void Gprs::Join(const std::string& apnName, BoolResultCallback cb) {
@@ -76,7 +101,7 @@ void Gprs::Join(const std::string& apnName, BoolResultCallback cb) {
       return;
     }
     // Bring up gprs connection
-    Execute("AT+CIICR\r\n", { {"OK"} }, connectGprsCb);
+    Execute(AtCommands::kBringUpWireless, connectGprsCb);
   };
 
   auto shutCb = [cb, setApnCb, apnName, this](bool result) {
@@ -85,46 +110,164 @@ void Gprs::Join(const std::string& apnName, BoolResultCallback cb) {
       this->PostCallbackWithArgs(cb, false);
       return;
     }
-    Execute("AT+CSTT=\"" + apnName + "\",\"\",\"\"\r\n", { {"OK"} }, setApnCb);
+    Execute(AtCommands::kSetApn, setApnCb, apnName.c_str());
 
   };
   ShutConnection(shutCb);
 }
 
 void Gprs::StartConnection(const std::string& address, std::size_t port, ConnectionType connectionType, BoolResultCallback cb) {
+  connectionType_ = connectionType;
+  maxSegmentSize_ = 0;
   auto cipHeadCb = [this, cb, address, port, connectionType](OptionalString result) {
     if (!result) {
       BOOST_LOG_TRIVIAL(error) << "Can't set ciphead";
       this->PostCallbackWithArgs(cb, false);
       return;
     }
-    std::ostringstream cmd;
-    cmd << "AT+CIPSTART=\"" << connectionType << "\",\"" << address << "\"," << port << "\r\n";
-    using namespace std::chrono_literals;
-    Execute(cmd.str(), { {"OK"}, {"CONNECT OK"} }, [cb, this](OptionalString result) {
-      PostCallbackWithArgs(cb, bool(result));
-      }, 6s);
+    ExecuteForStatus(AtCommands::kStartConnection, cb, ConnectionTypeToString(connectionType).c_str(), address.c_str(), port);
   };
-  Execute("AT+CIPHEAD=1\r\n", { {"OK"} }, cipHeadCb);
+  if (!quickSend_) {
+    Execute(AtCommands::kShowIpHeader, cipHeadCb);
+    return;
+  }
+  // A segmented send failed before it could leave quick send mode.
+  ExecuteForStatus(AtCommands::kQuickSend, [this, cipHeadCb](bool result) {
+    quickSend_ = !result;
+    Execute(AtCommands::kShowIpHeader, cipHeadCb);
+    }, 0);
 }
 
 void Gprs::SendData(const std::vector<char>& data, BoolResultCallback cb) {
-  std::ostringstream cmd;
-  auto sendWhenPossible = [cb, data, this](OptionalString result) {
+  // Payload and callback live in members, so the continuations capture only this and
+  // std::function keeps them inline.
+  sendData_.assign(data.begin(), data.end());
+  sendCb_ = std::move(cb);
+  auto maxSegmentSize = maxSegmentSize_ > 0 ? maxSegmentSize_ : kDefaultSegmentSize;
+  if (connectionType_ == ConnectionType::TCP && sendData_.size() > maxSegmentSize) {
+    SendSegmented();
+    return;
+  }
+  ExecuteForStatus(AtCommands::kSendPrompt, [this](bool result) {
     if (!result) {
-      PostCallbackWithArgs(cb, false);
+      PostCallbackWithArgs(sendCb_, false);
       return;
     }
-    Execute(std::string(data.begin(), data.end()), { {"SEND OK"} }, [cb, this](OptionalString result) {
-      PostCallbackWithArgs(cb, bool(result));
+    WriteForStatus({ sendData_.data(), sendData_.size() }, AtCommands::kSendPayload, [this](bool result) {
+      PostCallbackWithArgs(sendCb_, bool(result));
       });
-  };
-  cmd << "AT+CIPSEND=" << data.size() << "\r\n";
-  Execute(cmd.str(), { {">"} }, sendWhenPossible);
+    }, sendData_.size());
+}
+
+void Gprs::SendSegmented() {
+  sentOffset_ = 0;
+  unacknowledged_ = 0;
+  lastAckProgressAt_ = std::chrono::steady_clock::now();
+  if (maxSegmentSize_ > 0) {
+    StartQuickSend();
+    return;
+  }
+  Execute(AtCommands::kSendBufferSize, [this](OptionalString result) {
+    auto size = result ? ParseReplyField(result.value(), "+CIPSEND:", 0) : std::experimental::nullopt;
+    if (!size || size.value() <= 0) {
+      BOOST_LOG_TRIVIAL(warning) << "Can't read the CIPSEND limit, using " << kDefaultSegmentSize;
+    }
+    maxSegmentSize_ = size && size.value() > 0 ? static_cast<std::size_t>(size.value()) : kDefaultSegmentSize;
+    StartQuickSend();
+    });
+}
+
+void Gprs::StartQuickSend() {
+  BOOST_LOG_TRIVIAL(info) << "Sending " << sendData_.size() << " bytes in segments of " << maxSegmentSize_;
+  ExecuteForStatus(AtCommands::kQuickSend, [this](bool result) {
+    if (!result) {
+      PostCallbackWithArgs(sendCb_, false);
+      return;
+    }
+    quickSend_ = true;
+    SendNextSegment();
+    }, 1);
+}
+
+void Gprs::SendNextSegment() {
+  auto size = std::min(maxSegmentSize_, sendData_.size() - sentOffset_);
+  // Done handing out, or the modem's window is full, either way wait for the peer.
+  if (size == 0 || unacknowledged_ + size > kSegmentsInFlight * maxSegmentSize_) {
+    PollAcknowledged();
+    return;
+  }
+  ExecuteForStatus(AtCommands::kSendPrompt, [this, size](bool result) {
+    if (!result) {
+      CompleteSegmented(false);
+      return;
+    }
+    WriteForStatus({ sendData_.data() + sentOffset_, size }, AtCommands::kQuickSendPayload, [this, size](bool result) {
+      if (!result) {
+        CompleteSegmented(false);
+        return;
+      }
+      sentOffset_ += size;
+      unacknowledged_ += size;
+      SendNextSegment();
+      });
+    }, size);
+}
+
+void Gprs::PollAcknowledged() {
+  Execute(AtCommands::kAcknowledged, std::bind(&Gprs::OnAcknowledged, this, std::placeholders::_1));
+}
+
+void Gprs::OnAcknowledged(OptionalString result) {
+  auto pending = result ? ParseReplyField(result.value(), "+CIPACK:", 2) : std::experimental::nullopt;
+  if (!pending || pending.value() < 0) {
+    BOOST_LOG_TRIVIAL(error) << "Can't read the acknowledged bytes";
+    CompleteSegmented(false);
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  auto unacknowledged = static_cast<std::size_t>(pending.value());
+  if (unacknowledged < unacknowledged_) {
+    lastAckProgressAt_ = now;
+  }
+  unacknowledged_ = unacknowledged;
+  auto size = std::min(maxSegmentSize_, sendData_.size() - sentOffset_);
+  if (size == 0 && unacknowledged_ == 0) {
+    CompleteSegmented(true);
+    return;
+  }
+  if (size > 0 && unacknowledged_ + size <= kSegmentsInFlight * maxSegmentSize_) {
+    SendNextSegment();
+    return;
+  }
+  if (now - lastAckProgressAt_ >= kAckTimeout) {
+    BOOST_LOG_TRIVIAL(error) << "Peer stopped acknowledging, " << unacknowledged_ << " bytes pending";
+    CompleteSegmented(false);
+    return;
+  }
+  ackPollTimeout_.expires_from_now(kAckPollInterval);
+  ackPollTimeout_.async_wait(std::bind(&Gprs::OnAckPollTimeout, this, std::placeholders::_1));
+}
+
+void Gprs::OnAckPollTimeout(const boost::system::error_code& error) {
+  if (!error) {
+    PollAcknowledged();
+  }
+}
+
+void Gprs::CompleteSegmented(bool result) {
+  // Single CIPSENDs wait for SEND OK again, which already means acknowledged by the peer.
+  // The delivery stands either way, a mode switch that failed is retried by StartConnection.
+  ExecuteForStatus(AtCommands::kQuickSend, [this, result](bool disabled) {
+    quickSend_ = !disabled;
+    if (!disabled) {
+      BOOST_LOG_TRIVIAL(warning) << "Can't leave quick send mode";
+    }
+    PostCallbackWithArgs(sendCb_, bool(result));
+    }, 0);
 }
 
 void Gprs::StartReading(StringResultCallback dataPart) {
-  ReadSomeUntilContainsOrWord({ {"+IPD,"}, {":"} }, "CLOSED",
+  ReadSomeUntilContainsOrWord(AtCommands::kIncomingDataHeader, AtCommands::kConnectionClosed,
     [this, dataPart](OptionalString result) {
       if (!result) {
         PostCallbackWithArgs(dataPart, std::move(result));
@@ -138,24 +281,56 @@ void Gprs::StartReading(StringResultCallback dataPart) {
     });
 }
 
+void Gprs::StopReading() {
+  CancelRead();
+}
+
+bool Gprs::HasIncomingData() {
+  return HasPendingData();
+}
+
+void Gprs::SetSlowClock(bool enable, BoolResultCallback cb) {
+  ExecuteForStatus(AtCommands::kSlowClock, std::move(cb), enable ? 1 : 0);
+}
+
+void Gprs::CheckAlive(BoolResultCallback cb) {
+  ExecuteForStatus(AtCommands::kAt, std::move(cb));
+}
+
+void Gprs::GetSignalQuality(IntResultCallback cb) {
+  Execute(AtCommands::kSignalQuality, [cb, this](OptionalString result) {
+    if (!result) {
+      PostCallbackWithArgs(cb, std::experimental::optional<int>());
+      return;
+    }
+    PostCallbackWithArgs(cb, ParseReplyField(result.value(), "+CSQ:", 0));
+    });
+}
+
+void Gprs::GetRegistrationStatus(IntResultCallback cb) {
+  Execute(AtCommands::kRegistrationStatus, [cb, this](OptionalString result) {
+    if (!result) {
+      PostCallbackWithArgs(cb, std::experimental::optional<int>());
+      return;
+    }
+    PostCallbackWithArgs(cb, ParseReplyField(result.value(), "+CREG:", 1));
+    });
+}
+
 void Gprs::CloseTCP(BoolResultCallback cb) {
-  using namespace std::chrono_literals;
-  Execute("AT+CIPCLOSE\r\n", { {"CLOSE OK"} },
-    [cb, this](OptionalString result) {
-      PostCallbackWithArgs(cb, bool(result));
-    }, 6s);
+  CancelRead();
+  ExecuteForStatus(AtCommands::kCloseConnection, std::move(cb));
 }
 
 void Gprs::GetIPAddress(StringResultCallback cb) {
-  Execute("AT+CIFSR\r\n", { {"."},{"."},{"."},{"\n"} }, cb);
+  Execute(AtCommands::kGetIpAddress, cb);
 }
 
 void Gprs::ShutConnection(BoolResultCallback cb) {
-  using namespace std::chrono_literals;
-  Execute("AT+CIPSHUT\r\n", { {"OK"}, {"SHUT OK"} },
-    [cb, this](OptionalString result) {
-      PostCallbackWithArgs(cb, bool(result));
-    }, 6s);
+  ackPollTimeout_.cancel();
+  // The reader may still wait for +IPD, the reply to CIPSHUT is not for it.
+  CancelRead();
+  ExecuteForStatus(AtCommands::kShutConnection, std::move(cb));
 }
 
 void Gprs::CheckSimStatusCb(BoolResultCallback cb, OptionalString success) {
@@ -165,7 +340,7 @@ void Gprs::CheckSimStatusCb(BoolResultCallback cb, OptionalString success) {
   }
   if (retryCount_ < 3) {
     ++retryCount_;
-    Execute("AT+CPIN?\r\n", { {"+CPIN: READY"} }, std::bind(&Gprs::CheckSimStatusCb, this, std::move(cb), std::placeholders::_1));
+    Execute(AtCommands::kSimStatus, std::bind(&Gprs::CheckSimStatusCb, this, std::move(cb), std::placeholders::_1));
     return;
   }
   BOOST_LOG_TRIVIAL(error) << "Check sim status failed";
@@ -174,5 +349,5 @@ void Gprs::CheckSimStatusCb(BoolResultCallback cb, OptionalString success) {
 
 void Gprs::CheckSimStatus(BoolResultCallback cb) {
   retryCount_ = 0;
-  Execute("AT+CPIN?\r\n", { {"+CPIN: READY"} }, std::bind(&Gprs::CheckSimStatusCb, this, std::move(cb), std::placeholders::_1));
+  Execute(AtCommands::kSimStatus, std::bind(&Gprs::CheckSimStatusCb, this, std::move(cb), std::placeholders::_1));
 }
\ No newline at end of file
@@ -13,6 +13,7 @@
 class Gprs : public Sim800 {
 public:
     using BoolResultCallback = std::function<void(bool)>;
+    using IntResultCallback = std::function<void(std::experimental::optional<int>)>;
     enum class ConnectionType {
         TCP = 0,
         UDP = 1,
@@ -21,20 +22,48 @@ public:
     void Init(BoolResultCallback cb);
     void Join(const std::string& apnName, BoolResultCallback cb);
     void StartConnection(const std::string& address, std::size_t port, ConnectionType connectionType, BoolResultCallback cb);
+    // Over TCP a payload larger than one CIPSEND is split into segments of the modem's send buffer
+    // size, pipelined in quick send mode and throttled on the unacknowledged bytes AT+CIPACK
+    // reports. cb gets true once the peer acknowledged all of it.
     void SendData(const std::vector<char>& data, BoolResultCallback cb);
     void StartReading(Sim800::StringResultCallback dataPartCb);
+    // Abandons the read StartReading left pending, so a command can follow.
+    void StopReading();
     void CloseTCP(BoolResultCallback cb);
     void ShutConnection(BoolResultCallback cb);
     void GetIPAddress(Sim800::StringResultCallback cb);
+    bool HasIncomingData();
+    void SetSlowClock(bool enable, BoolResultCallback cb);
+    void CheckAlive(BoolResultCallback cb);
+    void GetSignalQuality(IntResultCallback cb);
+    void GetRegistrationStatus(IntResultCallback cb);
 
 
 private:
     void CheckSimStatusCb(BoolResultCallback cb, OptionalString success);
     void CheckSimStatus(BoolResultCallback cb);
+    void SendSegmented();
+    void StartQuickSend();
+    void SendNextSegment();
+    void PollAcknowledged();
+    void OnAcknowledged(OptionalString result);
+    void OnAckPollTimeout(const boost::system::error_code& error);
+    void CompleteSegmented(bool result);
 
 private:
     uint retryCount_ = 0;
     std::experimental::optional<BoolResultCallback> stopReadingCb_;
+    std::vector<char> sendData_;
+    BoolResultCallback sendCb_;
+    ConnectionType connectionType_ = ConnectionType::TCP;
+    // CIPSEND limit of the current connection, 0 until queried.
+    std::size_t maxSegmentSize_ = 0;
+    bool quickSend_ = false;
+    // Segmented send progress, bytes handed to the modem and not yet acknowledged by the peer.
+    std::size_t sentOffset_ = 0;
+    std::size_t unacknowledged_ = 0;
+    std::chrono::steady_clock::time_point lastAckProgressAt_;
+    Timeout ackPollTimeout_;
 };
 
 #endif // GPRS_HPP
\ No newline at end of file
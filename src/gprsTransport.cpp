@@ -0,0 +1,56 @@
+#include "gprsTransport.hpp"
+
+#include <boost/log/trivial.hpp>
+
+
+GprsTransport::GprsTransport(Gprs& gprs, const Config& config) : gprs_(gprs), config_(config) {
+}
+
+const char* GprsTransport::GetName() const {
+  return "gprs";
+}
+
+bool GprsTransport::IsReliable() const {
+  return config_.connectionType == Gprs::ConnectionType::TCP;
+}
+
+void GprsTransport::Connect(const std::string& address, std::size_t port, BoolResultCallback cb) {
+  address_ = address;
+  port_ = port;
+  connectCb_ = std::move(cb);
+  gprs_.Init(std::bind(&GprsTransport::OnInit, this, std::placeholders::_1));
+}
+
+void GprsTransport::Send(const std::vector<char>& data, BoolResultCallback cb) {
+  gprs_.SendData(data, std::move(cb));
+}
+
+void GprsTransport::Receive(DataCallback cb) {
+  gprs_.StartReading(std::move(cb));
+}
+
+void GprsTransport::CancelReceive() {
+  gprs_.StopReading();
+}
+
+void GprsTransport::Close(BoolResultCallback cb) {
+  gprs_.ShutConnection(std::move(cb));
+}
+
+void GprsTransport::OnInit(bool result) {
+  if (!result) {
+    BOOST_LOG_TRIVIAL(error) << "GPRS init failed";
+    connectCb_(false);
+    return;
+  }
+  gprs_.Join(config_.apnName, std::bind(&GprsTransport::OnJoin, this, std::placeholders::_1));
+}
+
+void GprsTransport::OnJoin(bool result) {
+  if (!result) {
+    BOOST_LOG_TRIVIAL(error) << "GPRS join failed";
+    connectCb_(false);
+    return;
+  }
+  gprs_.StartConnection(address_, port_, config_.connectionType, connectCb_);
+}
@@ -0,0 +1,41 @@
+#ifndef GPRS_TRANSPORT_HPP
+#define GPRS_TRANSPORT_HPP
+
+#include <string>
+
+#include "gprs.hpp"
+#include "transport.hpp"
+
+// The SIM800 data connection: Connect() runs init, join and CIPSTART on a Gprs that may be shared
+// with other users of the modem, as long as they don't issue commands at the same time.
+class GprsTransport : public Transport {
+public:
+    struct Config {
+        std::string apnName;
+        Gprs::ConnectionType connectionType = Gprs::ConnectionType::TCP;
+    };
+
+    GprsTransport(Gprs& gprs, const Config& config);
+
+    const char* GetName() const override;
+    bool IsReliable() const override;
+    void Connect(const std::string& address, std::size_t port, BoolResultCallback cb) override;
+    void Send(const std::vector<char>& data, BoolResultCallback cb) override;
+    void Receive(DataCallback cb) override;
+    void CancelReceive() override;
+    // CIPSHUT, which works from any connection state.
+    void Close(BoolResultCallback cb) override;
+
+private:
+    void OnInit(bool result);
+    void OnJoin(bool result);
+
+private:
+    Gprs& gprs_;
+    Config config_;
+    std::string address_;
+    std::size_t port_ = 0;
+    BoolResultCallback connectCb_;
+};
+
+#endif // GPRS_TRANSPORT_HPP
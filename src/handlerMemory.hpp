@@ -0,0 +1,101 @@
+#ifndef HANDLER_MEMORY_HPP
+#define HANDLER_MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Preallocated storage for one handler that's posted over and over, typically from one thread to
+// another thread's io_service where asio's per thread recycling doesn't help. asio allocates the
+// operation through the handler's associated allocator, so while the slot is free a post never
+// touches the heap. Callers keep at most one such post in flight, a second one falls back to
+// operator new. asio releases the memory before it invokes the handler, so the handler itself
+// may post again.
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* Allocate(std::size_t size) {
+        if (size <= sizeof(storage_) && !inUse_.exchange(true, std::memory_order_acquire)) {
+            return &storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void Deallocate(void* pointer) {
+        if (pointer == &storage_) {
+            inUse_.store(false, std::memory_order_release);
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    static constexpr std::size_t kSlotSize = 256;
+    alignas(std::max_align_t) unsigned char storage_[kSlotSize];
+    std::atomic<bool> inUse_{ false };
+};
+
+template<typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : memory_(&memory) {}
+    template<typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_(other.memory_) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(memory_->Allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* pointer, std::size_t) {
+        memory_->Deallocate(pointer);
+    }
+
+    template<typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept {
+        return memory_ == other.memory_;
+    }
+
+    template<typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept {
+        return memory_ != other.memory_;
+    }
+
+private:
+    template<typename> friend class HandlerAllocator;
+    HandlerMemory* memory_;
+};
+
+template<typename Handler>
+class PooledHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    PooledHandler(HandlerMemory& memory, Handler handler) : memory_(&memory), handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type(*memory_);
+    }
+
+    template<typename... Args>
+    void operator()(Args&&... args) {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory* memory_;
+    Handler handler_;
+};
+
+template<typename Handler>
+PooledHandler<typename std::decay<Handler>::type> MakePooledHandler(HandlerMemory& memory, Handler&& handler) {
+    return PooledHandler<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+}
+
+#endif // HANDLER_MEMORY_HPP
@@ -0,0 +1,256 @@
+#include "latencyProbe.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+
+namespace
+{
+  constexpr const char kSendStampTag[] = "\"probe\": \"send\"";
+  constexpr std::size_t kMaxStampSize = 96;
+  // Largest batch the publisher sends plus a stamp frame, below the SIM800 CIPSEND limit.
+  constexpr std::size_t kMaxStampedBatchSize = 1460;
+  constexpr std::int64_t kSeenWindow = 64;
+
+  std::int64_t ToMicroseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  }
+
+  std::string FormatMs(std::int64_t us) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1) << us / 1000.0 << " ms";
+    return oss.str();
+  }
+}
+
+void LatencyProbe::Histogram::Record(std::int64_t us) {
+  if (count_ == 0 || us < min_) {
+    min_ = us;
+  }
+  if (count_ == 0 || us > max_) {
+    max_ = us;
+  }
+  ++count_;
+  if (us < 0) {
+    ++negative_;
+  }
+  ++counts_[BucketOf(us)];
+}
+
+std::size_t LatencyProbe::Histogram::GetCount() const {
+  return count_;
+}
+
+std::int64_t LatencyProbe::Histogram::GetPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<std::uint64_t>(std::max(percentile / 100.0 * count_, 1.0));
+  std::uint64_t seen = 0;
+  for (std::size_t bucket = 0; bucket < kBuckets; ++bucket) {
+    seen += counts_[bucket];
+    if (seen >= rank) {
+      return std::clamp(BucketValue(bucket), min_, max_);
+    }
+  }
+  return max_;
+}
+
+std::string LatencyProbe::Histogram::Summary() const {
+  if (count_ == 0) {
+    return "no samples";
+  }
+  std::ostringstream oss;
+  oss << "n " << count_ << ", min " << FormatMs(min_) << ", p50 " << FormatMs(GetPercentile(50))
+    << ", p90 " << FormatMs(GetPercentile(90)) << ", p99 " << FormatMs(GetPercentile(99)) << ", max " << FormatMs(max_);
+  if (negative_ > 0) {
+    oss << ", " << negative_ << " negative";
+  }
+  return oss.str();
+}
+
+std::size_t LatencyProbe::Histogram::BucketOf(std::int64_t us) {
+  if (us < static_cast<std::int64_t>(kSubBuckets)) {
+    return static_cast<std::size_t>(std::max<std::int64_t>(us, 0));
+  }
+  std::size_t exponent = 63 - __builtin_clzll(static_cast<unsigned long long>(us));
+  auto mantissa = static_cast<std::size_t>(us >> (exponent - 3)) & (kSubBuckets - 1);
+  return std::min((exponent - 2) * kSubBuckets + mantissa, kBuckets - 1);
+}
+
+std::int64_t LatencyProbe::Histogram::BucketValue(std::size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return static_cast<std::int64_t>(bucket);
+  }
+  auto exponent = bucket / kSubBuckets + 2;
+  auto mantissa = static_cast<std::int64_t>(bucket % kSubBuckets);
+  auto width = std::int64_t{ 1 } << (exponent - 3);
+  // Middle of the bucket.
+  return (kSubBuckets + mantissa) * width + width / 2;
+}
+
+LatencyProbe::LatencyProbe() {
+  stampPayload_.reserve(kMaxStampSize);
+  stampFrame_.reserve(2 * kMaxStampSize);
+  stampedBatch_.reserve(kMaxStampedBatchSize);
+}
+
+std::int64_t LatencyProbe::ToWallMicroseconds(Clock::time_point time) {
+  auto wall = std::chrono::system_clock::now() - (Clock::now() - time);
+  return std::chrono::duration_cast<std::chrono::microseconds>(wall.time_since_epoch()).count();
+}
+
+void LatencyProbe::Start(TelemetryCodec::Type codec) {
+  stampCodec_.SetType(codec);
+  // The start time is unique enough to tell runs of one publisher apart.
+  run_ = ToWallMicroseconds(Clock::now());
+}
+
+void LatencyProbe::OnFrameQueued(Clock::time_point sampledAt, Clock::time_point encodedAt, Clock::time_point now) {
+  sensorToEncoded_.Record(ToMicroseconds(encodedAt - sampledAt));
+  encodedToModem_.Record(ToMicroseconds(now - encodedAt));
+}
+
+void LatencyProbe::OnFrameDequeued(Clock::time_point queuedAt, Clock::time_point now) {
+  backlogWait_.Record(ToMicroseconds(now - queuedAt));
+}
+
+const std::vector<char>& LatencyProbe::StampBatch(const std::vector<char>& batch) {
+  stampPayload_.resize(stampPayload_.capacity());
+  auto size = std::snprintf(stampPayload_.data(), stampPayload_.size(), "{%s, \"run\": %lld, \"sentAt\": %lld}", kSendStampTag,
+    static_cast<long long>(run_), static_cast<long long>(ToWallMicroseconds(Clock::now())));
+  stampPayload_.resize(std::max(size, 0));
+  stampedBatch_.clear();
+  if (size > 0 && stampCodec_.Encode(stampPayload_, stampFrame_)) {
+    stampedBatch_.insert(stampedBatch_.end(), stampFrame_.begin(), stampFrame_.end());
+  }
+  stampedBatch_.insert(stampedBatch_.end(), batch.begin(), batch.end());
+  return stampedBatch_;
+}
+
+void LatencyProbe::OnSendCompleted(Clock::duration latency, bool success) {
+  if (!success) {
+    ++failedSends_;
+    return;
+  }
+  send_.Record(ToMicroseconds(latency));
+}
+
+void LatencyProbe::ReportPublisher() const {
+  BOOST_LOG_TRIVIAL(info) << "Probe sensor read to encoded: " << sensorToEncoded_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Probe encoded to modem thread: " << encodedToModem_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Probe backlog wait for AT send: " << backlogWait_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Probe CIPSEND to SEND OK: " << send_.Summary() << ", failed sends " << failedSends_;
+}
+
+bool LatencyProbe::OnFrame(const std::vector<char>& frame) {
+  auto receivedAt = ToWallMicroseconds(Clock::now());
+  bool complete = false;
+  bool telemetry = false;
+  // Uncompressed chunks may carry several objects, or parts of them.
+  objects_.Feed(frame, [this, receivedAt, &complete, &telemetry](const std::vector<char>& object) {
+    complete = true;
+    telemetry |= OnObject(object, receivedAt);
+  });
+  return telemetry || !complete;
+}
+
+void LatencyProbe::OnStreamRestarted() {
+  objects_.Reset();
+}
+
+void LatencyProbe::ReportSubscriber() const {
+  BOOST_LOG_TRIVIAL(info) << "Probe sensor read to received: " << sensorToReceived_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Probe send to received (air and server): " << sentToReceived_.Summary()
+    << ", clock offset bound " << FormatMs(minSentToReceived_);
+  BOOST_LOG_TRIVIAL(info) << "Probe received " << counters_.received << ", missing " << counters_.missing
+    << ", reordered " << counters_.reordered << ", duplicates " << counters_.duplicates
+    << ", publisher restarts " << counters_.restarts;
+}
+
+const LatencyProbe::Counters& LatencyProbe::GetCounters() const {
+  return counters_;
+}
+
+bool LatencyProbe::OnObject(const std::vector<char>& object, std::int64_t receivedAt) {
+  auto stamp = std::search(object.begin(), object.end(), kSendStampTag, kSendStampTag + sizeof(kSendStampTag) - 1);
+  if (stamp != object.end()) {
+    std::int64_t run = 0;
+    if (FindIntegerField(object, "run", run)) {
+      OnRun(run);
+    }
+    if (!FindIntegerField(object, "sentAt", sentAt_)) {
+      sentAt_ = -1;
+    }
+    return false;
+  }
+  std::int64_t seq = 0;
+  std::int64_t sensedAt = 0;
+  if (FindIntegerField(object, "seq", seq) && FindIntegerField(object, "sensedAt", sensedAt)) {
+    OnSample(seq, sensedAt, receivedAt);
+  }
+  return true;
+}
+
+// A new run restarts the sequence numbers, whatever was seen before says nothing about them.
+void LatencyProbe::OnRun(std::int64_t run) {
+  if (run == publisherRun_) {
+    return;
+  }
+  if (publisherRun_ >= 0) {
+    ++counters_.restarts;
+    highestSeq_ = -1;
+    seenWindow_ = 0;
+  }
+  publisherRun_ = run;
+}
+
+void LatencyProbe::OnSample(std::int64_t seq, std::int64_t sensedAt, std::int64_t receivedAt) {
+  ++counters_.received;
+  TrackSequence(seq);
+  sensorToReceived_.Record(receivedAt - sensedAt);
+  if (sentAt_ < 0) {
+    return;
+  }
+  auto delay = receivedAt - sentAt_;
+  if (sentToReceived_.GetCount() == 0 || delay < minSentToReceived_) {
+    minSentToReceived_ = delay;
+  }
+  sentToReceived_.Record(delay);
+}
+
+void LatencyProbe::TrackSequence(std::int64_t seq) {
+  if (highestSeq_ < 0 || seq > highestSeq_) {
+    if (highestSeq_ >= 0) {
+      auto gap = seq - highestSeq_;
+      counters_.missing += gap - 1;
+      seenWindow_ = gap >= kSeenWindow ? 0 : seenWindow_ << gap;
+    }
+    seenWindow_ |= 1;
+    highestSeq_ = seq;
+    return;
+  }
+  auto age = highestSeq_ - seq;
+  if (age >= kSeenWindow) {
+    // Far behind everything seen, a publisher without run stamps started counting again.
+    ++counters_.restarts;
+    highestSeq_ = seq;
+    seenWindow_ = 1;
+    return;
+  }
+  auto bit = std::uint64_t{ 1 } << age;
+  if (seenWindow_ & bit) {
+    ++counters_.duplicates;
+    return;
+  }
+  seenWindow_ |= bit;
+  ++counters_.reordered;
+  // Arrived before anything older than it, it was never counted as missing.
+  if (counters_.missing > 0) {
+    --counters_.missing;
+  }
+}
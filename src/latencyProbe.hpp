@@ -0,0 +1,115 @@
+#ifndef LATENCY_PROBE_HPP
+#define LATENCY_PROBE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "objectStream.hpp"
+#include "telemetryCodec.hpp"
+
+// End to end latency of the uplink, measured in --probe mode on both ends.
+//
+// The publisher adds "seq" and "sensedAt" (wall clock microseconds of the sensor read) to every
+// sample and puts a {"probe": "send", "run": ..., "sentAt": ...} frame in front of every batch when
+// its CIPSEND starts. "run" tells the subscriber a restarted publisher from duplicates. Its own stages are timed locally: sensor read to encoded, handoff to the modem
+// thread, waiting in the backlog for an AT send slot, and CIPSEND to SEND OK. The subscriber times
+// what is left, air and server, against the sentAt stamps and counts loss, reordering and
+// duplicates from the sequence numbers.
+//
+// Cross host delays need the two wall clocks to agree. The server only relays publisher to
+// subscriber, so there is no path for an in-band ping-pong; both hosts rely on NTP, which does that
+// exchange with its time servers. The minimum send to receive delay is reported as well: it bounds
+// the remaining offset, a negative one means the clocks are off by at least that much.
+class LatencyProbe {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Log-linear histogram of microseconds, 8 buckets per power of two, about 12% resolution.
+    // Fixed size, recording never allocates.
+    class Histogram {
+    public:
+        void Record(std::int64_t us);
+        std::size_t GetCount() const;
+        std::int64_t GetPercentile(double percentile) const;
+        std::string Summary() const;
+
+    private:
+        static constexpr std::size_t kSubBuckets = 8;
+        static constexpr std::size_t kBuckets = 40 * kSubBuckets;
+
+        static std::size_t BucketOf(std::int64_t us);
+        static std::int64_t BucketValue(std::size_t bucket);
+
+    private:
+        std::array<std::uint64_t, kBuckets> counts_{};
+        std::size_t count_ = 0;
+        std::size_t negative_ = 0;
+        std::int64_t min_ = 0;
+        std::int64_t max_ = 0;
+    };
+
+    struct Counters {
+        std::size_t received = 0;
+        std::size_t missing = 0;
+        std::size_t reordered = 0;
+        std::size_t duplicates = 0;
+        std::size_t restarts = 0;
+    };
+
+    LatencyProbe();
+
+    static std::int64_t ToWallMicroseconds(Clock::time_point time);
+
+    // Publisher side, stamps are encoded with the negotiated codec.
+    void Start(TelemetryCodec::Type codec);
+    void OnFrameQueued(Clock::time_point sampledAt, Clock::time_point encodedAt, Clock::time_point now);
+    void OnFrameDequeued(Clock::time_point queuedAt, Clock::time_point now);
+    // Returns the batch with the send stamp in front, valid until the next call.
+    const std::vector<char>& StampBatch(const std::vector<char>& batch);
+    void OnSendCompleted(Clock::duration latency, bool success);
+    void ReportPublisher() const;
+
+    // Subscriber side, returns false for frames that complete only send stamps. Uncompressed
+    // streams split objects anywhere, a frame without a complete object counts as telemetry.
+    bool OnFrame(const std::vector<char>& frame);
+    // The connection was replaced, an object cut off by the old one is dropped.
+    void OnStreamRestarted();
+    void ReportSubscriber() const;
+    const Counters& GetCounters() const;
+
+private:
+    // Returns false for a send stamp.
+    bool OnObject(const std::vector<char>& object, std::int64_t receivedAt);
+    void OnRun(std::int64_t run);
+    void OnSample(std::int64_t seq, std::int64_t sensedAt, std::int64_t receivedAt);
+    void TrackSequence(std::int64_t seq);
+
+private:
+    // Publisher
+    std::int64_t run_ = -1;
+    TelemetryCodec stampCodec_;
+    std::vector<char> stampPayload_;
+    std::vector<char> stampFrame_;
+    std::vector<char> stampedBatch_;
+    Histogram sensorToEncoded_;
+    Histogram encodedToModem_;
+    Histogram backlogWait_;
+    Histogram send_;
+    std::size_t failedSends_ = 0;
+    // Subscriber
+    ObjectStream objects_;
+    std::int64_t sentAt_ = -1;
+    std::int64_t publisherRun_ = -1;
+    Histogram sensorToReceived_;
+    Histogram sentToReceived_;
+    std::int64_t minSentToReceived_ = 0;
+    std::int64_t highestSeq_ = -1;
+    // Bit n set when highestSeq_ - n has arrived.
+    std::uint64_t seenWindow_ = 0;
+    Counters counters_;
+};
+
+#endif // LATENCY_PROBE_HPP
@@ -0,0 +1,158 @@
+#include "linkBonding.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+
+
+LinkBonding::LinkBonding(boost::asio::io_service& ioService, const Config& config) : config_(config) {
+  for (std::size_t i = 0; i < config_.devices.size(); ++i) {
+    ModemLink::Config linkConfig;
+    linkConfig.name = "modem" + std::to_string(i);
+    linkConfig.device = config_.devices[i];
+    linkConfig.apnName = config_.apnName;
+    linkConfig.serverAddress = config_.serverAddress;
+    linkConfig.serverPort = config_.serverPort;
+    linkConfig.offeredCodec = config_.offeredCodec;
+    auto slot = std::make_unique<Slot>();
+    slot->link = std::make_unique<ModemLink>(ioService, linkConfig);
+    slot->batch.reserve(config_.maxBatchSize);
+    slots_.push_back(std::move(slot));
+  }
+}
+
+void LinkBonding::Start(ReadyCallback ready, BatchSource source, SendCompletedCallback sent) {
+  readyCb_ = std::move(ready);
+  source_ = std::move(source);
+  sentCb_ = std::move(sent);
+  for (auto& slot : slots_) {
+    BOOST_LOG_TRIVIAL(info) << "Bonding " << slot->link->GetConfig().name << " on " << slot->link->GetConfig().device;
+    slot->link->Start(std::bind(&LinkBonding::OnLinkStateChanged, this, std::placeholders::_1));
+  }
+}
+
+void LinkBonding::Dispatch() {
+  if (!ready_ || shuttingDown_) {
+    return;
+  }
+  while (auto slot = PickSlot()) {
+    if (!retry_.empty()) {
+      slot->batch = std::move(retry_.front());
+      retry_.pop_front();
+    }
+    else if (!source_(slot->batch)) {
+      return;
+    }
+    slot->link->Send(slot->batch, std::bind(&LinkBonding::OnDataSend, this, std::ref(*slot), std::placeholders::_1));
+  }
+}
+
+void LinkBonding::Shutdown(ShutdownCallback done) {
+  if (shuttingDown_) {
+    return;
+  }
+  shuttingDown_ = true;
+  shutdownCb_ = std::move(done);
+  CloseLinksWhenIdle();
+}
+
+void LinkBonding::Report() const {
+  std::size_t totalBytes = 0;
+  for (const auto& slot : slots_) {
+    totalBytes += slot->link->GetStats().bytes;
+  }
+  for (const auto& slot : slots_) {
+    const auto& link = *slot->link;
+    const auto& stats = link.GetStats();
+    BOOST_LOG_TRIVIAL(info) << "Link " << link.GetConfig().name << " (" << link.GetConfig().device << ") "
+      << ModemLink::StateToString(link.GetState()) << (slot->excluded ? " excluded" : "")
+      << ": sent " << stats.bytes << " bytes in " << stats.sends << " sends"
+      << " (" << 100.0 * stats.bytes / std::max<std::size_t>(totalBytes, 1) << "% share)"
+      << ", failures " << stats.failures << ", goodput " << stats.goodputBps << " B/s"
+      << ", reconnects " << stats.reconnects;
+  }
+  BOOST_LOG_TRIVIAL(info) << "Bonded uplink sent " << totalBytes << " bytes, " << retry_.size() << " batches waiting for retry";
+}
+
+void LinkBonding::OnLinkStateChanged(ModemLink& link) {
+  if (link.GetState() == ModemLink::State::READY && !closing_) {
+    auto slot = std::find_if(slots_.begin(), slots_.end(), [&link](const auto& s) { return s->link.get() == &link; });
+    if (!ready_) {
+      ready_ = true;
+      codec_ = link.GetCodec();
+      readyCb_(codec_);
+    }
+    (*slot)->excluded = link.GetCodec() != codec_;
+    if ((*slot)->excluded) {
+      BOOST_LOG_TRIVIAL(warning) << "Link " << link.GetConfig().name << " negotiated codec "
+        << TelemetryCodec::TypeToString(link.GetCodec()) << " instead of " << TelemetryCodec::TypeToString(codec_) << ", not used";
+    }
+  }
+  if (shuttingDown_) {
+    CloseLinksWhenIdle();
+    return;
+  }
+  Dispatch();
+}
+
+void LinkBonding::OnDataSend(Slot& slot, bool result) {
+  if (!result) {
+    // Queued ahead of new data, the next healthy link takes it as soon as this one is down.
+    retry_.push_back(std::move(slot.batch));
+    slot.batch = std::vector<char>();
+    slot.batch.reserve(config_.maxBatchSize);
+  }
+  else {
+    sentCb_();
+  }
+  if (shuttingDown_) {
+    CloseLinksWhenIdle();
+    return;
+  }
+  Dispatch();
+}
+
+LinkBonding::Slot* LinkBonding::PickSlot() {
+  Slot* best = nullptr;
+  auto bestCompletion = ModemLink::Clock::duration::max();
+  for (auto& slot : slots_) {
+    if (!slot->link->IsUp() || slot->excluded) {
+      continue;
+    }
+    auto completion = slot->link->EstimateCompletion(config_.maxBatchSize);
+    if (completion < bestCompletion) {
+      best = slot.get();
+      bestCompletion = completion;
+    }
+  }
+  if (!best || best->link->GetState() != ModemLink::State::READY) {
+    return nullptr;
+  }
+  return best;
+}
+
+bool LinkBonding::IsSending() const {
+  return std::any_of(slots_.begin(), slots_.end(), [](const auto& slot) {
+    return slot->link->GetState() == ModemLink::State::SENDING;
+    });
+}
+
+void LinkBonding::CloseLinksWhenIdle() {
+  if (closing_ || IsSending()) {
+    return;
+  }
+  closing_ = true;
+  linksToClose_ = slots_.size();
+  for (auto& slot : slots_) {
+    slot->link->Close(std::bind(&LinkBonding::OnLinkClosed, this, std::placeholders::_1));
+  }
+}
+
+void LinkBonding::OnLinkClosed(bool result) {
+  if (!result) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to close a bonded link";
+  }
+  if (--linksToClose_ == 0) {
+    shutdownCb_();
+  }
+}
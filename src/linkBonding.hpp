@@ -0,0 +1,81 @@
+#ifndef LINK_BONDING_HPP
+#define LINK_BONDING_HPP
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "modemLink.hpp"
+#include "telemetryCodec.hpp"
+
+// Spreads the publisher uplink over several modems, each with its own TCP session to the server.
+//
+// Each link carries one batch at a time. A batch goes to the link expected to complete it first,
+// counting what that link still has in flight and its measured goodput. When that link is busy
+// the batch waits for it rather than going out on a slower idle one. A failed batch is queued for
+// retry ahead of new data and handed to the next healthy link at once, so one carrier's outage
+// doesn't open a delivery gap. A batch whose send failed after reaching the server is sent again,
+// the server sees it twice.
+class LinkBonding {
+public:
+    using ReadyCallback = std::function<void(TelemetryCodec::Type codec)>;
+    // Moves the next batch of queued frames into batch, false when nothing is queued.
+    using BatchSource = std::function<bool(std::vector<char>& batch)>;
+    using SendCompletedCallback = std::function<void()>;
+    using ShutdownCallback = std::function<void()>;
+
+    struct Config {
+        std::vector<std::string> devices;
+        std::string apnName;
+        std::string serverAddress;
+        std::size_t serverPort = 0;
+        TelemetryCodec::Type offeredCodec = TelemetryCodec::Type::NONE;
+        // Batch size assumed when comparing links, BatchSource never returns more.
+        std::size_t maxBatchSize = 1024;
+    };
+
+    LinkBonding(boost::asio::io_service& ioService, const Config& config);
+
+    // ready is called once, when the first link is up. Frames are encoded with the codec it
+    // negotiated, links that end up with another codec are left out.
+    void Start(ReadyCallback ready, BatchSource source, SendCompletedCallback sent);
+    // Sends queued batches on every link that should take one now.
+    void Dispatch();
+    // Stops taking new batches, waits for the sends in flight and closes every link.
+    void Shutdown(ShutdownCallback done);
+    void Report() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<ModemLink> link;
+        std::vector<char> batch;
+        bool excluded = false;
+    };
+
+    void OnLinkStateChanged(ModemLink& link);
+    void OnDataSend(Slot& slot, bool result);
+    Slot* PickSlot();
+    bool IsSending() const;
+    void CloseLinksWhenIdle();
+    void OnLinkClosed(bool result);
+
+private:
+    Config config_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::deque<std::vector<char>> retry_;
+    bool ready_ = false;
+    TelemetryCodec::Type codec_ = TelemetryCodec::Type::NONE;
+    ReadyCallback readyCb_;
+    BatchSource source_;
+    SendCompletedCallback sentCb_;
+    bool shuttingDown_ = false;
+    bool closing_ = false;
+    std::size_t linksToClose_ = 0;
+    ShutdownCallback shutdownCb_;
+};
+
+#endif // LINK_BONDING_HPP
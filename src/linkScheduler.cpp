@@ -0,0 +1,131 @@
+#include "linkScheduler.hpp"
+
+#include <boost/log/trivial.hpp>
+#include <wiringPi.h>
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  // SIM800 needs DTR low for at least 50 ms before it accepts commands again.
+  constexpr std::chrono::milliseconds kDtrSettleTime = 100ms;
+  constexpr std::chrono::milliseconds kInitialWakeLead = 1000ms;
+  constexpr std::chrono::milliseconds kWakeLeadMargin = 200ms;
+}
+
+LinkScheduler::LinkScheduler(boost::asio::io_service& ioService, Gprs& gprs, const Config& config) : gprs_(gprs),
+config_(config),
+timeout_(ioService) {
+  stats_.wakeLead = kInitialWakeLead;
+}
+
+void LinkScheduler::Start(WindowOpenCallback windowOpen, Gprs::BoolResultCallback cb) {
+  windowOpenCb_ = std::move(windowOpen);
+  pinMode(config_.dtrPin, OUTPUT);
+  digitalWrite(config_.dtrPin, LOW);
+  gprs_.SetSlowClock(true, [this, cb](bool result) {
+    if (!result) {
+      BOOST_LOG_TRIVIAL(error) << "Failed to enable slow clock";
+      cb(false);
+      return;
+    }
+    stateChangedAt_ = Clock::now();
+    Sleep();
+    cb(true);
+    });
+}
+
+bool LinkScheduler::IsWindowOpen() const {
+  return isWindowOpen_;
+}
+
+void LinkScheduler::OnDataQueued() {
+  if (!asleep_ || wakeScheduled_) {
+    return;
+  }
+  wakeScheduled_ = true;
+  deadline_ = Clock::now() + config_.maxLatency;
+  auto wakeAt = deadline_ - stats_.wakeLead;
+  timeout_.expires_from_now(std::max(wakeAt - Clock::now(), Clock::duration::zero()));
+  timeout_.async_wait(std::bind(&LinkScheduler::OnWakeTimeout, this, std::placeholders::_1));
+}
+
+void LinkScheduler::OnDataSent() {
+  if (sentInWindow_) {
+    return;
+  }
+  sentInWindow_ = true;
+  stats_.lastWakeToSend = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - wakeStartedAt_);
+  // Smooth the lead so one slow wakeup doesn't keep the modem awake longer forever.
+  auto target = stats_.lastWakeToSend + kWakeLeadMargin;
+  stats_.wakeLead = (stats_.wakeLead * 3 + target) / 4;
+}
+
+void LinkScheduler::CloseWindow() {
+  if (!isWindowOpen_) {
+    return;
+  }
+  isWindowOpen_ = false;
+  auto now = Clock::now();
+  stats_.awake += now - stateChangedAt_;
+  stateChangedAt_ = now;
+  ++stats_.windows;
+  Report();
+  Sleep();
+}
+
+const LinkScheduler::Stats& LinkScheduler::GetStats() const {
+  return stats_;
+}
+
+void LinkScheduler::Sleep() {
+  // With slow clock enabled the modem sleeps as soon as DTR is high and the UART is idle.
+  digitalWrite(config_.dtrPin, HIGH);
+  asleep_ = true;
+  wakeScheduled_ = false;
+}
+
+void LinkScheduler::OnWakeTimeout(const boost::system::error_code& error) {
+  if (error) {
+    return;
+  }
+  auto now = Clock::now();
+  stats_.asleep += now - stateChangedAt_;
+  stateChangedAt_ = now;
+  wakeStartedAt_ = now;
+  sentInWindow_ = false;
+  digitalWrite(config_.dtrPin, LOW);
+  timeout_.expires_from_now(kDtrSettleTime);
+  timeout_.async_wait(std::bind(&LinkScheduler::OnDtrSettled, this, std::placeholders::_1));
+}
+
+void LinkScheduler::OnDtrSettled(const boost::system::error_code& error) {
+  if (error) {
+    return;
+  }
+  gprs_.CheckAlive(std::bind(&LinkScheduler::OnModemAlive, this, std::placeholders::_1));
+}
+
+void LinkScheduler::OnModemAlive(bool result) {
+  if (!result) {
+    BOOST_LOG_TRIVIAL(error) << "Modem didn't wake up";
+    windowOpenCb_(false);
+    return;
+  }
+  asleep_ = false;
+  wakeScheduled_ = false;
+  isWindowOpen_ = true;
+  windowOpenCb_(true);
+}
+
+void LinkScheduler::Report() {
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+  auto total = stats_.awake + stats_.asleep;
+  auto dutyCycle = total.count() ? 100.0 * stats_.awake.count() / total.count() : 100.0;
+  BOOST_LOG_TRIVIAL(info) << "Uplink window " << stats_.windows
+    << ": wake-to-send " << stats_.lastWakeToSend.count() << " ms"
+    << ", wake lead " << stats_.wakeLead.count() << " ms"
+    << ", deadline slack " << duration_cast<milliseconds>(deadline_ - Clock::now()).count() << " ms"
+    << ", duty cycle " << dutyCycle << "%";
+}
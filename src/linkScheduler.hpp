@@ -0,0 +1,70 @@
+#ifndef LINK_SCHEDULER_HPP
+#define LINK_SCHEDULER_HPP
+
+#include <chrono>
+#include <functional>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/high_resolution_timer.hpp>
+
+#include "gprs.hpp"
+
+// Keeps the SIM800 in slow clock sleep (AT+CSCLK=1, DTR high) between uplink windows.
+//
+// The first frame queued while asleep sets the delivery deadline to now + maxLatency.
+// The modem is woken ahead of the deadline by the measured wake-to-send latency, the
+// owner flushes everything accumulated and calls CloseWindow(), which puts it back to sleep.
+// A larger maxLatency means fewer, bigger windows and a lower duty cycle.
+class LinkScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using WindowOpenCallback = std::function<void(bool)>;
+
+    struct Config {
+        std::chrono::milliseconds maxLatency{ 60000 };
+        int dtrPin = 7;
+    };
+
+    struct Stats {
+        std::size_t windows = 0;
+        std::chrono::milliseconds lastWakeToSend{ 0 };
+        std::chrono::milliseconds wakeLead{ 0 };
+        Clock::duration awake{ 0 };
+        Clock::duration asleep{ 0 };
+    };
+
+    LinkScheduler(boost::asio::io_service& ioService, Gprs& gprs, const Config& config);
+
+    // Enables slow clock and puts the modem to sleep, windows are announced through windowOpen.
+    void Start(WindowOpenCallback windowOpen, Gprs::BoolResultCallback cb);
+    bool IsWindowOpen() const;
+    void OnDataQueued();
+    void OnDataSent();
+    void CloseWindow();
+    const Stats& GetStats() const;
+
+private:
+    void Sleep();
+    void OnWakeTimeout(const boost::system::error_code& error);
+    void OnDtrSettled(const boost::system::error_code& error);
+    void OnModemAlive(bool result);
+    void Report();
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    Gprs& gprs_;
+    Config config_;
+    Timeout timeout_;
+    WindowOpenCallback windowOpenCb_;
+    bool asleep_ = false;
+    bool isWindowOpen_ = false;
+    bool wakeScheduled_ = false;
+    bool sentInWindow_ = false;
+    Clock::time_point deadline_;
+    Clock::time_point wakeStartedAt_;
+    Clock::time_point stateChangedAt_;
+    Stats stats_;
+};
+
+#endif // LINK_SCHEDULER_HPP
@@ -0,0 +1,359 @@
+#include "loadGenerator.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  constexpr std::chrono::milliseconds kConnectTick = 10ms;
+  // What a stalled publisher keeps queued, newer samples are dropped beyond it.
+  constexpr std::size_t kMaxBatchSize = 64 * 1024;
+  constexpr const char kPadField[] = ", \"pad\": \"";
+
+  std::int64_t ToMicroseconds(LoadGenerator::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  }
+
+  // Publishers and subscribers share the process, so the steady clock works as a sample timestamp.
+  std::int64_t NowMicroseconds() {
+    return ToMicroseconds(LoadGenerator::Clock::now().time_since_epoch());
+  }
+
+  // Drops completions of a connection the client has since torn down.
+  template<typename Client, typename Handler>
+  auto IfCurrent(Client& client, Handler handler) {
+    return [&client, generation = client.generation, handler](auto&&... args) {
+      if (client.generation != generation) {
+        return;
+      }
+      handler(std::forward<decltype(args)>(args)...);
+    };
+  }
+}
+
+LoadGenerator::Client::Client(boost::asio::io_service& ioService, std::size_t id, ClientProtocol::ClientType type,
+  TelemetryCodec::Type offered) : id(id),
+  type(type),
+  offered(offered),
+  transport(ioService),
+  timer(ioService) {
+}
+
+LoadGenerator::LoadGenerator(boost::asio::io_service& ioService, const Config& config) : ioService_(ioService),
+config_(config),
+random_(std::random_device()()),
+connectTimeout_(ioService),
+churnTimeout_(ioService),
+reportTimeout_(ioService),
+durationTimeout_(ioService) {
+  auto total = config_.subscribers + config_.publishers;
+  clients_.reserve(total);
+  for (std::size_t i = 0; i < total; ++i) {
+    // Subscribers connect first, so they are in place before the publishers start sending.
+    auto type = i < config_.subscribers ? ClientProtocol::ClientType::SUBSCRIBER : ClientProtocol::ClientType::PUBLISHER;
+    clients_.push_back(std::make_unique<Client>(ioService_, i, type, config_.codecs[i % config_.codecs.size()]));
+  }
+}
+
+void LoadGenerator::Start() {
+  BOOST_LOG_TRIVIAL(info) << "Starting " << config_.publishers << " publishers at " << config_.rate << " samples/s and "
+    << config_.subscribers << " subscribers against " << config_.serverAddress << ":" << config_.serverPort;
+  startedAt_ = Clock::now();
+  ConnectNextBatch();
+  ScheduleChurn();
+  ScheduleReport();
+  durationTimeout_.expires_from_now(config_.duration);
+  durationTimeout_.async_wait([this](const boost::system::error_code& error) {
+    if (!error) {
+      Finish();
+    }
+    });
+}
+
+void LoadGenerator::Report() const {
+  auto elapsed = std::chrono::duration<double>(Clock::now() - startedAt_).count();
+  BOOST_LOG_TRIVIAL(info) << "Ran " << elapsed << " s with " << config_.publishers << " publishers and "
+    << config_.subscribers << " subscribers, " << connected_ << " connected at the end";
+  BOOST_LOG_TRIVIAL(info) << "Connects " << counters_.connects << ", connect failures " << counters_.connectFailures
+    << ", handshake failures " << counters_.handshakeFailures << ", churned " << counters_.churned
+    << ", errors " << counters_.errors << ", decode errors " << counters_.decodeErrors;
+  BOOST_LOG_TRIVIAL(info) << "Sent " << counters_.samplesSent << " samples (" << counters_.samplesSent / elapsed << "/s), "
+    << counters_.bytesSent << " bytes (" << counters_.bytesSent / elapsed << " B/s), dropped " << counters_.samplesDropped;
+  BOOST_LOG_TRIVIAL(info) << "Received " << counters_.samplesReceived << " samples (" << counters_.samplesReceived / elapsed << "/s), "
+    << counters_.bytesReceived << " bytes (" << counters_.bytesReceived / elapsed << " B/s)";
+  BOOST_LOG_TRIVIAL(info) << "Connect and handshake: " << connectLatency_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Send to server acknowledged: " << sendLatency_.Summary();
+  BOOST_LOG_TRIVIAL(info) << "Sample built to decoded by a subscriber: " << endToEndLatency_.Summary();
+}
+
+const LoadGenerator::Counters& LoadGenerator::GetCounters() const {
+  return counters_;
+}
+
+void LoadGenerator::Connect(Client& client) {
+  client.state = State::CONNECTING;
+  client.connectStartedAt = Clock::now();
+  client.transport.Connect(config_.serverAddress, config_.serverPort,
+    IfCurrent(client, [this, &client](bool result) { OnConnected(client, result); }));
+}
+
+void LoadGenerator::OnConnected(Client& client, bool result) {
+  if (!result) {
+    Fail(client, counters_.connectFailures);
+    return;
+  }
+  auto handshake = ClientProtocol::BuildHandshake(client.type, client.offered);
+  client.inFlight.assign(handshake.begin(), handshake.end());
+  client.transport.Send(client.inFlight, IfCurrent(client, [this, &client](bool result) { OnHandshakeSend(client, result); }));
+}
+
+void LoadGenerator::OnHandshakeSend(Client& client, bool result) {
+  if (!result) {
+    Fail(client, counters_.handshakeFailures);
+    return;
+  }
+  client.transport.Receive(IfCurrent(client, [this, &client](Transport::OptionalString reply) { OnHandshakeReply(client, reply); }));
+}
+
+void LoadGenerator::OnHandshakeReply(Client& client, Transport::OptionalString reply) {
+  auto negotiated = TelemetryCodec::Type::NONE;
+  if (!reply || !ClientProtocol::ParseHandshakeReply(reply.value(), client.offered, negotiated)) {
+    Fail(client, counters_.handshakeFailures);
+    return;
+  }
+  client.codec.SetType(negotiated);
+  client.state = State::READY;
+  ++connected_;
+  ++counters_.connects;
+  connectLatency_.Record(ToMicroseconds(Clock::now() - client.connectStartedAt));
+  if (client.type == ClientProtocol::ClientType::SUBSCRIBER) {
+    // Relayed frames can arrive in the same chunk, right behind the reply line.
+    auto replySize = ClientProtocol::HandshakeReplySize(reply.value(), negotiated);
+    if (reply->size() > replySize) {
+      Decode(client, reply->substr(replySize));
+    }
+    Receive(client);
+    return;
+  }
+  // Spread the publishers over the sample period instead of sending in lockstep.
+  std::uniform_real_distribution<double> phase(0.0, 1.0 / config_.rate);
+  ScheduleSample(client, Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(phase(random_))));
+}
+
+void LoadGenerator::ScheduleSample(Client& client, Clock::time_point at) {
+  client.timer.expires_at(at);
+  client.timer.async_wait(IfCurrent(client, [this, &client](const boost::system::error_code& error) {
+    if (!error) {
+      OnSampleDue(client);
+    }
+    }));
+}
+
+void LoadGenerator::OnSampleDue(Client& client) {
+  auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / config_.rate));
+  ScheduleSample(client, client.timer.expiry() + period);
+  char head[192];
+  auto size = std::snprintf(head, sizeof(head), "{\"client\": %zu, \"seq\": %u, \"sentAt\": %lld, "
+    "\"temperature\": 21.3, \"humidity\": 41, \"pressure\": 1013.2", client.id, client.seq++,
+    static_cast<long long>(NowMicroseconds()));
+  client.payload.assign(head, head + std::max(size, 0));
+  // Padded up to the configured size, the closing quote and brace included.
+  auto padded = client.payload.size() + sizeof(kPadField) - 1 + 2;
+  if (config_.payloadSize > padded) {
+    client.payload.insert(client.payload.end(), kPadField, kPadField + sizeof(kPadField) - 1);
+    client.payload.insert(client.payload.end(), config_.payloadSize - padded, 'x');
+    client.payload.push_back('"');
+  }
+  client.payload.push_back('}');
+  if (!client.codec.Encode(client.payload, client.frame)) {
+    ++counters_.samplesDropped;
+    return;
+  }
+  if (client.batch.size() + client.frame.size() > kMaxBatchSize) {
+    ++counters_.samplesDropped;
+    return;
+  }
+  client.batch.insert(client.batch.end(), client.frame.begin(), client.frame.end());
+  ++client.batchSamples;
+  if (!client.sending) {
+    SendBatch(client);
+  }
+}
+
+void LoadGenerator::SendBatch(Client& client) {
+  client.inFlight.swap(client.batch);
+  client.batch.clear();
+  client.inFlightSamples = client.batchSamples;
+  client.batchSamples = 0;
+  client.sending = true;
+  client.sendStartedAt = Clock::now();
+  client.transport.Send(client.inFlight, IfCurrent(client, [this, &client](bool result) { OnSendCompleted(client, result); }));
+}
+
+void LoadGenerator::OnSendCompleted(Client& client, bool result) {
+  client.sending = false;
+  if (!result) {
+    Fail(client, counters_.errors);
+    return;
+  }
+  sendLatency_.Record(ToMicroseconds(Clock::now() - client.sendStartedAt));
+  counters_.samplesSent += client.inFlightSamples;
+  counters_.bytesSent += client.inFlight.size();
+  if (!client.batch.empty()) {
+    SendBatch(client);
+  }
+}
+
+void LoadGenerator::Receive(Client& client) {
+  client.transport.Receive(IfCurrent(client, [this, &client](Transport::OptionalString data) { OnData(client, data); }));
+}
+
+void LoadGenerator::OnData(Client& client, Transport::OptionalString data) {
+  if (!data) {
+    Fail(client, counters_.errors);
+    return;
+  }
+  Decode(client, data.value());
+  Receive(client);
+}
+
+void LoadGenerator::Decode(Client& client, const std::string& chunk) {
+  counters_.bytesReceived += chunk.size();
+  auto onFrame = [this](const std::vector<char>& frame) { OnFrame(frame); };
+  auto decoded = client.codec.Decode(chunk, [&client, &onFrame](const std::vector<char>& frame) {
+    if (client.codec.GetType() == TelemetryCodec::Type::NONE) {
+      client.objects.Feed(frame, onFrame);
+      return;
+    }
+    onFrame(frame);
+    });
+  if (!decoded) {
+    ++counters_.decodeErrors;
+  }
+}
+
+void LoadGenerator::OnFrame(const std::vector<char>& frame) {
+  std::int64_t sentAt = 0;
+  // Other publishers on a shared server don't stamp their samples.
+  if (!FindIntegerField(frame, "sentAt", sentAt)) {
+    return;
+  }
+  ++counters_.samplesReceived;
+  endToEndLatency_.Record(NowMicroseconds() - sentAt);
+}
+
+void LoadGenerator::Disconnect(Client& client) {
+  if (client.state == State::READY) {
+    --connected_;
+  }
+  ++client.generation;
+  client.state = State::IDLE;
+  client.sending = false;
+  client.batch.clear();
+  client.batchSamples = 0;
+  client.objects = ObjectStream();
+  client.timer.cancel();
+  client.transport.Close([](bool) {});
+}
+
+void LoadGenerator::Fail(Client& client, std::size_t& counter) {
+  ++counter;
+  Disconnect(client);
+  if (finished_) {
+    return;
+  }
+  client.timer.expires_from_now(config_.reconnectDelay);
+  client.timer.async_wait(IfCurrent(client, [this, &client](const boost::system::error_code& error) {
+    if (!error) {
+      Connect(client);
+    }
+    }));
+}
+
+void LoadGenerator::ConnectNextBatch() {
+  auto perTick = std::max<long>(std::lround(config_.connectRate * std::chrono::duration<double>(kConnectTick).count()), 1);
+  for (long i = 0; i < perTick && nextToConnect_ < clients_.size(); ++i) {
+    Connect(*clients_[nextToConnect_++]);
+  }
+  if (nextToConnect_ == clients_.size()) {
+    return;
+  }
+  connectTimeout_.expires_from_now(kConnectTick);
+  connectTimeout_.async_wait([this](const boost::system::error_code& error) {
+    if (!error) {
+      ConnectNextBatch();
+    }
+    });
+}
+
+void LoadGenerator::ScheduleChurn() {
+  if (config_.churnRate <= 0.0) {
+    return;
+  }
+  // Disconnects arrive independently of each other, exponentially distributed gaps.
+  std::exponential_distribution<double> gap(config_.churnRate);
+  churnTimeout_.expires_from_now(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(random_))));
+  churnTimeout_.async_wait([this](const boost::system::error_code& error) {
+    if (!error) {
+      OnChurn();
+    }
+    });
+}
+
+void LoadGenerator::OnChurn() {
+  std::uniform_int_distribution<std::size_t> pick(0, clients_.size() - 1);
+  // A few tries are enough unless most of the fleet is down anyway.
+  for (int attempt = 0; attempt < 8 && connected_ > 0; ++attempt) {
+    auto& client = *clients_[pick(random_)];
+    if (client.state == State::READY) {
+      Fail(client, counters_.churned);
+      break;
+    }
+  }
+  ScheduleChurn();
+}
+
+void LoadGenerator::ScheduleReport() {
+  reportTimeout_.expires_from_now(config_.reportInterval);
+  reportTimeout_.async_wait([this](const boost::system::error_code& error) {
+    if (!error) {
+      ReportProgress();
+      ScheduleReport();
+    }
+    });
+}
+
+void LoadGenerator::ReportProgress() {
+  auto seconds = std::chrono::duration<double>(config_.reportInterval).count();
+  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - startedAt_).count();
+  BOOST_LOG_TRIVIAL(info) << elapsed << " s: connected " << connected_ << "/" << clients_.size()
+    << ", sent " << (counters_.samplesSent - lastReported_.samplesSent) / seconds << " samples/s ("
+    << (counters_.bytesSent - lastReported_.bytesSent) / seconds << " B/s)"
+    << ", received " << (counters_.samplesReceived - lastReported_.samplesReceived) / seconds << " samples/s ("
+    << (counters_.bytesReceived - lastReported_.bytesReceived) / seconds << " B/s)"
+    << ", errors " << counters_.errors - lastReported_.errors
+    << ", end to end p50 " << endToEndLatency_.GetPercentile(50) / 1000.0 << " ms, p99 " << endToEndLatency_.GetPercentile(99) / 1000.0 << " ms";
+  lastReported_ = counters_;
+}
+
+void LoadGenerator::Finish() {
+  finished_ = true;
+  connectTimeout_.cancel();
+  churnTimeout_.cancel();
+  reportTimeout_.cancel();
+  for (auto& client : clients_) {
+    if (client->state != State::IDLE) {
+      Disconnect(*client);
+    }
+    else {
+      client->timer.cancel();
+    }
+  }
+  // Lets the closes posted above run before the loop stops.
+  ioService_.post([this]() { ioService_.stop(); });
+}
@@ -0,0 +1,150 @@
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio/high_resolution_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "clientProtocol.hpp"
+#include "latencyProbe.hpp"
+#include "objectStream.hpp"
+#include "socketTransport.hpp"
+#include "telemetryCodec.hpp"
+
+// Simulates a fleet of publishers and subscribers on one io_service, every client on its own
+// SocketTransport with the handshake and codec frames App uses.
+//
+// Publishers send a sample every 1 / rate seconds, each tagged with its client id, sequence
+// number and the time it was built. A publisher whose previous send hasn't completed batches
+// its samples, like App does with its backlog. Subscribers decode whatever the server relays and
+// time every sample from being built to being decoded, both ends share the steady clock. Clients
+// connect at a bounded rate, churn drops random connected clients which reconnect after a delay.
+class LoadGenerator {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        std::string serverAddress = "127.0.0.1";
+        std::size_t serverPort = 0;
+        std::size_t publishers = 1000;
+        std::size_t subscribers = 10;
+        // Samples per second per publisher.
+        double rate = 1.0;
+        std::size_t payloadSize = 80;
+        // Offered round robin, client i offers codecs[i % size].
+        std::vector<TelemetryCodec::Type> codecs{ TelemetryCodec::Type::DEFLATE_DICT };
+        double connectRate = 500.0;
+        // Disconnects per second across the fleet.
+        double churnRate = 0.0;
+        std::chrono::milliseconds reconnectDelay{ 1000 };
+        std::chrono::seconds duration{ 30 };
+        std::chrono::seconds reportInterval{ 5 };
+    };
+
+    struct Counters {
+        std::size_t connects = 0;
+        std::size_t connectFailures = 0;
+        std::size_t handshakeFailures = 0;
+        std::size_t churned = 0;
+        std::size_t errors = 0;
+        std::size_t samplesSent = 0;
+        std::size_t bytesSent = 0;
+        // Samples a stalled publisher had to give up.
+        std::size_t samplesDropped = 0;
+        std::size_t samplesReceived = 0;
+        std::size_t bytesReceived = 0;
+        std::size_t decodeErrors = 0;
+    };
+
+    LoadGenerator(boost::asio::io_service& ioService, const Config& config);
+
+    // Runs until the configured duration is over, then closes every client and stops the loop.
+    void Start();
+    void Report() const;
+    const Counters& GetCounters() const;
+
+private:
+    enum class State {
+        IDLE,
+        CONNECTING,
+        READY,
+    };
+
+    struct Client {
+        Client(boost::asio::io_service& ioService, std::size_t id, ClientProtocol::ClientType type, TelemetryCodec::Type offered);
+
+        std::size_t id;
+        ClientProtocol::ClientType type;
+        TelemetryCodec::Type offered;
+        SocketTransport transport;
+        // Sample period or reconnect delay, steady so the sample rate doesn't drift.
+        boost::asio::steady_timer timer;
+        State state = State::IDLE;
+        // Bumped on every disconnect, callbacks of an earlier connection are ignored.
+        std::uint64_t generation = 0;
+        TelemetryCodec codec;
+        ObjectStream objects;
+        std::uint32_t seq = 0;
+        bool sending = false;
+        std::vector<char> payload;
+        std::vector<char> frame;
+        std::vector<char> batch;
+        std::size_t batchSamples = 0;
+        std::vector<char> inFlight;
+        std::size_t inFlightSamples = 0;
+        Clock::time_point connectStartedAt;
+        Clock::time_point sendStartedAt;
+    };
+
+    void Connect(Client& client);
+    void OnConnected(Client& client, bool result);
+    void OnHandshakeSend(Client& client, bool result);
+    void OnHandshakeReply(Client& client, Transport::OptionalString reply);
+    void ScheduleSample(Client& client, Clock::time_point at);
+    void OnSampleDue(Client& client);
+    void SendBatch(Client& client);
+    void OnSendCompleted(Client& client, bool result);
+    void Receive(Client& client);
+    void OnData(Client& client, Transport::OptionalString data);
+    void Decode(Client& client, const std::string& chunk);
+    void OnFrame(const std::vector<char>& frame);
+    void Disconnect(Client& client);
+    void Fail(Client& client, std::size_t& counter);
+
+    void ConnectNextBatch();
+    void ScheduleChurn();
+    void OnChurn();
+    void ScheduleReport();
+    void ReportProgress();
+    void Finish();
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    boost::asio::io_service& ioService_;
+    Config config_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::size_t nextToConnect_ = 0;
+    std::size_t connected_ = 0;
+    std::mt19937 random_;
+    Timeout connectTimeout_;
+    Timeout churnTimeout_;
+    Timeout reportTimeout_;
+    Timeout durationTimeout_;
+    bool finished_ = false;
+    Clock::time_point startedAt_;
+    Counters counters_;
+    Counters lastReported_;
+    LatencyProbe::Histogram connectLatency_;
+    LatencyProbe::Histogram sendLatency_;
+    LatencyProbe::Histogram endToEndLatency_;
+};
+
+#endif // LOAD_GENERATOR_HPP
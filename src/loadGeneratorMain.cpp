@@ -0,0 +1,187 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "loadGenerator.hpp"
+#include "serverStandIn.hpp"
+#include "telemetryCodec.hpp"
+
+
+namespace
+{
+  // A deflate frame length is 2 bytes, keep well below it.
+  constexpr std::size_t kMaxPayloadSize = 16 * 1024;
+
+  struct LoadConfig {
+    // Empty runs against the built in stand-in.
+    std::string server;
+    LoadGenerator::Config generator;
+    bool verbose = false;
+  };
+
+  void PrintUsage() {
+    std::cerr << "loadGenerator [options]\n"
+      << "  --server HOST:PORT      server to load, default a local stand-in\n"
+      << "  --publishers N          simulated publishers (default 1000)\n"
+      << "  --subscribers N         simulated subscribers (default 10)\n"
+      << "  --rate HZ               samples per second per publisher (default 1)\n"
+      << "  --payload BYTES         sample size before encoding (default 80)\n"
+      << "  --codecs C[,C...]       codecs offered round robin, none or deflate-v1 (default deflate-v1)\n"
+      << "  --connect-rate N        new connections per second (default 500)\n"
+      << "  --churn N               random disconnects per second across the fleet (default 0)\n"
+      << "  --reconnect-delay MS    pause before a dropped client reconnects (default 1000)\n"
+      << "  --duration S            length of the run (default 30)\n"
+      << "  --report-interval S     progress report period (default 5)\n"
+      << "  --verbose               log every connection error\n";
+  }
+
+  bool ParseCodecs(const std::string& list, std::vector<TelemetryCodec::Type>& codecs) {
+    codecs.clear();
+    std::istringstream iss(list);
+    std::string name;
+    while (std::getline(iss, name, ',')) {
+      TelemetryCodec::Type type;
+      if (!TelemetryCodec::TypeFromString(name, type)) {
+        return false;
+      }
+      codecs.push_back(type);
+    }
+    return !codecs.empty();
+  }
+
+  bool ParseArguments(int argc, char* argv[], LoadConfig& config) {
+    auto& generator = config.generator;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--server" && hasValue) {
+        config.server = argv[++i];
+        auto colon = config.server.rfind(':');
+        if (colon == std::string::npos) {
+          std::cerr << "Server must be HOST:PORT" << std::endl;
+          return false;
+        }
+        generator.serverAddress = config.server.substr(0, colon);
+        generator.serverPort = std::strtoul(config.server.c_str() + colon + 1, nullptr, 10);
+        continue;
+      }
+      if (arg == "--publishers" && hasValue) {
+        generator.publishers = std::strtoul(argv[++i], nullptr, 10);
+        continue;
+      }
+      if (arg == "--subscribers" && hasValue) {
+        generator.subscribers = std::strtoul(argv[++i], nullptr, 10);
+        continue;
+      }
+      if (arg == "--rate" && hasValue) {
+        generator.rate = std::max(std::atof(argv[++i]), 0.01);
+        continue;
+      }
+      if (arg == "--payload" && hasValue) {
+        generator.payloadSize = std::min<std::size_t>(std::strtoul(argv[++i], nullptr, 10), kMaxPayloadSize);
+        continue;
+      }
+      if (arg == "--codecs" && hasValue) {
+        if (!ParseCodecs(argv[++i], generator.codecs)) {
+          std::cerr << "Unknown codec in " << argv[i] << std::endl;
+          return false;
+        }
+        continue;
+      }
+      if (arg == "--connect-rate" && hasValue) {
+        generator.connectRate = std::max(std::atof(argv[++i]), 1.0);
+        continue;
+      }
+      if (arg == "--churn" && hasValue) {
+        generator.churnRate = std::max(std::atof(argv[++i]), 0.0);
+        continue;
+      }
+      if (arg == "--reconnect-delay" && hasValue) {
+        generator.reconnectDelay = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+        continue;
+      }
+      if (arg == "--duration" && hasValue) {
+        generator.duration = std::chrono::seconds(std::max(std::atoi(argv[++i]), 1));
+        continue;
+      }
+      if (arg == "--report-interval" && hasValue) {
+        generator.reportInterval = std::chrono::seconds(std::max(std::atoi(argv[++i]), 1));
+        continue;
+      }
+      if (arg == "--verbose") {
+        config.verbose = true;
+        continue;
+      }
+      std::cerr << "Unknown parameter: " << arg << std::endl;
+      PrintUsage();
+      return false;
+    }
+    return true;
+  }
+
+  // Every client holds a socket, the stand-in one more per client.
+  void RaiseDescriptorLimit(std::size_t needed) {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+      return;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed) {
+      BOOST_LOG_TRIVIAL(warning) << "Descriptor limit " << limit.rlim_cur << " is below the " << needed
+        << " the run needs, raise the hard limit (ulimit -Hn)";
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  LoadConfig config;
+  if (!ParseArguments(argc, argv, config)) {
+    return EXIT_FAILURE;
+  }
+  // Transports log their failures as errors, the report counts them and thousands of clients
+  // failing at once would drown it.
+  if (!config.verbose) {
+    boost::log::core::get()->set_filter(boost::log::trivial::severity != boost::log::trivial::error);
+  }
+  auto clients = config.generator.publishers + config.generator.subscribers;
+  RaiseDescriptorLimit((config.server.empty() ? 2 : 1) * clients + 64);
+
+  // The stand-in gets its own thread and loop, the clients' loop is what is being measured.
+  boost::asio::io_service standInService;
+  std::unique_ptr<ServerStandIn> standIn;
+  std::thread standInThread;
+  if (config.server.empty()) {
+    standIn = std::make_unique<ServerStandIn>(standInService, 0);
+    config.generator.serverPort = standIn->GetPort();
+    standIn->Start();
+    standInThread = std::thread([&standInService]() { standInService.run(); });
+  }
+
+  boost::asio::io_service ioService;
+  LoadGenerator generator(ioService, config.generator);
+  generator.Start();
+  ioService.run();
+
+  generator.Report();
+  if (standIn) {
+    standInService.stop();
+    standInThread.join();
+    const auto& counters = standIn->GetCounters();
+    BOOST_LOG_TRIVIAL(info) << "Stand-in connections " << counters.connections << " (" << counters.publishers << " publishers, "
+      << counters.subscribers << " subscribers), frames in " << counters.framesIn << ", frames out " << counters.framesOut
+      << " (" << counters.bytesOut << " bytes), dropped " << counters.droppedFrames << ", decode errors " << counters.decodeErrors;
+  }
+  return EXIT_SUCCESS;
+}
@@ -8,11 +8,26 @@
 
 #include <boost/asio.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
 #include <csignal>
 
+#include "allocationGuard.hpp"
+#include "batchController.hpp"
+#include "clientProtocol.hpp"
+#include "executor.hpp"
+#include "frameRing.hpp"
 #include "gprs.hpp"
-#include "bme280.hpp"
+#include "gprsTransport.hpp"
+#include "latencyProbe.hpp"
+#include "linkBonding.hpp"
+#include "linkScheduler.hpp"
+#include "shmRingWriter.hpp"
+#include "socketTransport.hpp"
+#include "telemetryCodec.hpp"
+#include "telemetryPipeline.hpp"
+#include "transportPolicy.hpp"
+#include "udpSession.hpp"
 
 namespace
 {
@@ -24,6 +39,22 @@ namespace
   constexpr const char kServerAddress[] = "chodowicz.pl";
   constexpr uint kServerPort = 9999;
   constexpr const char kApnName[] = "plus";
+  constexpr const char kDefaultShmRingName[] = "rpiclient-downlink";
+  constexpr uint32_t kShmRingSlots = 256;
+  constexpr uint32_t kShmRingSlotSize = 2048;
+  // Frames are coalesced into sends of at most this size, safely below the SIM800 CIPSEND limit.
+  constexpr std::size_t kMaxBatchSize = 1024;
+  // A backlog left by an outage drains in sends this large, the modem segments and pipelines them.
+  constexpr std::size_t kMaxBulkBatchSize = 8 * 1024;
+  constexpr std::size_t kMaxBacklogFrames = 4096;
+  constexpr std::size_t kBacklogArenaSize = 256 * 1024;
+  // Sends completed before the publisher counts as warmed up and the allocation guard is armed.
+  constexpr std::size_t kWarmupSends = 3;
+  constexpr std::chrono::seconds kLinkQualityInterval{ 30 };
+  // The +IPD header of an ack is buffered before it is read, only its few payload bytes can be late.
+  constexpr std::chrono::seconds kAckReadTimeout{ 2 };
+  // How often a bonded uplink looks for Ctrl-C, no send may complete while every link is down.
+  constexpr std::chrono::milliseconds kSignalCheckInterval{ 500 };
 
   auto initialize()
   {
@@ -34,55 +65,265 @@ namespace
     }
   }
 
-  enum class ClientType : bool {
-    PUBLISHER = 0,
-    SUBSCRIBER = 1,
+  using ClientProtocol::ClientType;
+
+  struct AppConfig {
+    ClientType clientType = ClientType::PUBLISHER;
+    TelemetryCodec::Type offeredCodec = TelemetryCodec::Type::DEFLATE_DICT;
+    Gprs::ConnectionType connectionType = Gprs::ConnectionType::TCP;
+    // More than one device bonds the modems into a single uplink.
+    std::vector<std::string> modems;
+    // Prefer a direct TCP connection over the host network, GPRS is the fallback.
+    bool socket = false;
+    int modemCpu = -1;
+    std::string shmRingName = kDefaultShmRingName;
+    bool dutyCycling = false;
+    bool adaptiveBatching = false;
+    std::string recordPath;
+    std::string replayPath;
+    bool replayFast = false;
+    bool failOnAllocation = false;
+    bool probe = false;
+    LinkScheduler::Config linkScheduler;
+    TelemetryPipeline::Config pipeline;
   };
 
-  std::string ClientTypeToString(ClientType clientType) {
-    if (clientType == ClientType::PUBLISHER) return "PUBLISHER";
-    return "SUBSCRIBER";
+  bool ParseCpuList(const std::string& list, std::vector<int>& cpus) {
+    std::istringstream iss(list);
+    std::string cpu;
+    while (std::getline(iss, cpu, ',')) {
+      try {
+        cpus.push_back(std::stoi(cpu));
+      }
+      catch (const std::exception&) {
+        return false;
+      }
+    }
+    return !cpus.empty();
   }
 
-  ClientType DeduceClientType(const std::string& ct) {
-    if (ct == "PUBLISHER") return ClientType::PUBLISHER;
-    return ClientType::SUBSCRIBER;
+  bool ParseArguments(int argc, char* argv[], AppConfig& config) {
+    if (argc < 2) {
+      BOOST_LOG_TRIVIAL(fatal) << "Wrong number of parameters";
+      return false;
+    }
+    config.clientType = ClientProtocol::DeduceClientType(argv[1]);
+    for (int i = 2; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg == "--codec" && i + 1 < argc) {
+        if (!TelemetryCodec::TypeFromString(argv[++i], config.offeredCodec)) {
+          BOOST_LOG_TRIVIAL(fatal) << "Unknown codec: " << argv[i];
+          return false;
+        }
+        continue;
+      }
+      if (arg == "--udp") {
+        config.connectionType = Gprs::ConnectionType::UDP;
+        continue;
+      }
+      if (arg == "--shm-ring" && i + 1 < argc) {
+        config.shmRingName = argv[++i];
+        continue;
+      }
+      if (arg == "--max-latency" && i + 1 < argc) {
+        config.dutyCycling = true;
+        config.linkScheduler.maxLatency = std::chrono::seconds(std::max(std::atoi(argv[++i]), 1));
+        continue;
+      }
+      if (arg == "--adaptive-batching") {
+        config.adaptiveBatching = true;
+        continue;
+      }
+      if (arg == "--dtr-pin" && i + 1 < argc) {
+        config.linkScheduler.dtrPin = std::atoi(argv[++i]);
+        continue;
+      }
+      if (arg == "--record" && i + 1 < argc) {
+        config.recordPath = argv[++i];
+        continue;
+      }
+      if (arg == "--replay" && i + 1 < argc) {
+        config.replayPath = argv[++i];
+        continue;
+      }
+      if (arg == "--replay-fast") {
+        config.replayFast = true;
+        continue;
+      }
+      if (arg == "--probe") {
+        config.probe = true;
+        config.pipeline.probe = true;
+        continue;
+      }
+      if (arg == "--fail-on-allocation") {
+        config.failOnAllocation = true;
+        continue;
+      }
+      if (arg == "--modem" && i + 1 < argc) {
+        config.modems.push_back(argv[++i]);
+        continue;
+      }
+      if (arg == "--socket") {
+        config.socket = true;
+        continue;
+      }
+      if (arg == "--modem-cpu" && i + 1 < argc) {
+        config.modemCpu = std::atoi(argv[++i]);
+        continue;
+      }
+      if (arg == "--sensor-cpu" && i + 1 < argc) {
+        config.pipeline.sensorCpu = std::atoi(argv[++i]);
+        continue;
+      }
+      if (arg == "--sample-rate" && i + 1 < argc) {
+        config.pipeline.sampleRate = std::max(std::atof(argv[++i]), 0.01);
+        continue;
+      }
+      if (arg == "--sample-interval" && i + 1 < argc) {
+        config.pipeline.sampleInterval = std::chrono::milliseconds(std::max(std::atoi(argv[++i]), 1));
+        continue;
+      }
+      if (arg == "--decimation-order" && i + 1 < argc) {
+        config.pipeline.decimationOrder = std::max(std::atoi(argv[++i]), 1);
+        continue;
+      }
+      if (arg == "--workers" && i + 1 < argc) {
+        config.pipeline.workers = std::max(std::atoi(argv[++i]), 1);
+        continue;
+      }
+      if (arg == "--worker-cpus" && i + 1 < argc) {
+        if (!ParseCpuList(argv[++i], config.pipeline.workerCpus)) {
+          BOOST_LOG_TRIVIAL(fatal) << "Invalid cpu list: " << argv[i];
+          return false;
+        }
+        continue;
+      }
+      BOOST_LOG_TRIVIAL(fatal) << "Unknown parameter: " << arg;
+      return false;
+    }
+    if (config.clientType == ClientType::PUBLISHER && !TelemetryPipeline::CheckDecimation(config.pipeline)) {
+      return false;
+    }
+    if (config.connectionType == Gprs::ConnectionType::UDP && config.clientType != ClientType::PUBLISHER) {
+      BOOST_LOG_TRIVIAL(fatal) << "UDP mode is supported only by PUBLISHER";
+      return false;
+    }
+    if (config.dutyCycling && (config.clientType != ClientType::PUBLISHER || config.connectionType != Gprs::ConnectionType::TCP)) {
+      BOOST_LOG_TRIVIAL(fatal) << "Duty cycling is supported only by TCP PUBLISHER";
+      return false;
+    }
+    if (config.adaptiveBatching && config.clientType != ClientType::PUBLISHER) {
+      BOOST_LOG_TRIVIAL(fatal) << "Adaptive batching is supported only by PUBLISHER";
+      return false;
+    }
+    if (config.modems.empty()) {
+      config.modems.push_back(kSerialName);
+    }
+    if (config.modems.size() > 1 && (config.clientType != ClientType::PUBLISHER || config.connectionType != Gprs::ConnectionType::TCP ||
+      config.dutyCycling || config.adaptiveBatching || !config.recordPath.empty() || !config.replayPath.empty())) {
+      BOOST_LOG_TRIVIAL(fatal) << "Several modems are supported only by TCP PUBLISHER without duty cycling, adaptive batching or tracing";
+      return false;
+    }
+    if (config.probe && (config.connectionType != Gprs::ConnectionType::TCP || config.modems.size() > 1)) {
+      BOOST_LOG_TRIVIAL(fatal) << "Latency probe is supported only over TCP with a single modem";
+      return false;
+    }
+    if (config.socket && (config.connectionType != Gprs::ConnectionType::TCP || config.modems.size() > 1 || config.dutyCycling ||
+      config.adaptiveBatching || !config.recordPath.empty() || !config.replayPath.empty())) {
+      BOOST_LOG_TRIVIAL(fatal) << "Socket transport is supported only over TCP with a single modem, without duty cycling, adaptive batching or tracing";
+      return false;
+    }
+    if (config.failOnAllocation && !AllocationGuard::IsEnabled()) {
+      BOOST_LOG_TRIVIAL(fatal) << "--fail-on-allocation needs a build with RPICLIENT_FIXED_MEMORY";
+      return false;
+    }
+    return true;
   }
 
   class App {
   public:
     using Timeout = boost::asio::high_resolution_timer;
-    App(ClientType ct) : ioService_(), serialPort_(ioService_), gprs_(serialPort_), ct_(ct), timeout_(ioService_) {};
+    App(const AppConfig& config) : ioService_(), serialPort_(ioService_), gprs_(serialPort_), ct_(config.clientType),
+      config_(config), backlog_(kMaxBacklogFrames, kBacklogArenaSize), pipeline_(ioService_, config.pipeline),
+      ringWriter_(ioService_), linkScheduler_(ioService_, gprs_, config.linkScheduler), flushTimeout_(ioService_), ackTimeout_(ioService_),
+      signalTimeout_(ioService_), uplink_(ioService_, { config.clientType, config.offeredCodec, kServerAddress, kServerPort }) {
+      frame_.reserve(kMaxBulkBatchSize + TelemetryPipeline::kMaxFrameSize);
+      // Cheapest first, the modem is only brought up when the host network fails.
+      if (config.socket) {
+        uplink_.Add(std::make_unique<SocketTransport>(ioService_));
+      }
+      uplink_.Add(std::make_unique<GprsTransport>(gprs_, GprsTransport::Config{ kApnName, config.connectionType }));
+    };
 
     void DoStuff() {
-      serialPort_.open(kSerialName, ec_);
-      if (ec_) {
-        BOOST_LOG_TRIVIAL(fatal) << "serial port open(), failed port name " << kSerialName;
-        std::exit(EXIT_FAILURE);
+      if (config_.modems.size() > 1) {
+        StartBonding();
+        return;
       }
-      serialPort_.set_option(boost::asio::serial_port::baud_rate(115200));
-      gprs_.Init(std::bind(&App::InitCb, this, std::placeholders::_1));
+      if (!config_.replayPath.empty()) {
+        // The trace stands in for the modem, no hardware needed.
+        if (!serialPort_.StartReplay(config_.replayPath, config_.replayFast, std::bind(&App::OnReplayFinished, this))) {
+          std::exit(EXIT_FAILURE);
+        }
+      }
+      else {
+        OpenSerialPort();
+      }
+      if (config_.dutyCycling) {
+        initialize();
+      }
+      // This thread owns the modem, everything else runs on the pipeline executors.
+      Executor::PinCurrentThread(config_.modemCpu);
+      AllocationGuard::TrackCurrentThread();
+      uplink_.Start(std::bind(&App::OnTransportReady, this, std::placeholders::_1));
       ioService_.run();
     }
 
-    void InitCb(bool success) {
-      if (!success) {
-        std::exit(EXIT_FAILURE);
-        return;
-      }
-      gprs_.Join(kApnName, std::bind(&App::JoinCb, this, std::placeholders::_1));
+    // Each modem gets its own Gprs state machine, all of them run on this thread.
+    void StartBonding() {
+      Executor::PinCurrentThread(config_.modemCpu);
+      AllocationGuard::TrackCurrentThread();
+      LinkBonding::Config bondingConfig;
+      bondingConfig.devices = config_.modems;
+      bondingConfig.apnName = kApnName;
+      bondingConfig.serverAddress = kServerAddress;
+      bondingConfig.serverPort = kServerPort;
+      bondingConfig.offeredCodec = config_.offeredCodec;
+      bondingConfig.maxBatchSize = kMaxBatchSize;
+      bonding_ = std::make_unique<LinkBonding>(ioService_, bondingConfig);
+      bonding_->Start(std::bind(&App::OnBondingReady, this, std::placeholders::_1),
+        std::bind(&App::PopBatch, this, std::placeholders::_1), std::bind(&App::OnBondedSend, this));
+      WatchForSignal();
+      ioService_.run();
     }
 
-    void JoinCb(bool success) {
-      if (!success) {
+    void OpenSerialPort() {
+      const auto& device = config_.modems.front();
+      serialPort_.open(device, ec_);
+      if (ec_) {
+        BOOST_LOG_TRIVIAL(fatal) << "serial port open(), failed port name " << device;
         std::exit(EXIT_FAILURE);
-        return;
       }
-      // gprs_.GetIPAddress(std::bind(&App::GetIpCb, this, std::placeholders::_1));
-      gprs_.StartConnection(kServerAddress, kServerPort, Gprs::ConnectionType::TCP, std::bind(&App::StartConnectionCb, this, std::placeholders::_1));
+      serialPort_.set_option(boost::asio::serial_port::baud_rate(115200));
+      if (!config_.recordPath.empty() && !serialPort_.StartRecording(config_.recordPath)) {
+        std::exit(EXIT_FAILURE);
+      }
+    }
+
+    // The recorded session is over, so is the run, the link going away now is only the end of the
+    // recording. It passes when every TX matched the trace, a steady state allocation aborted already.
+    void OnReplayFinished() {
+      ReportAllocations();
+      pipeline_.Stop();
+      ReportPipelineCounters();
+      auto mismatches = serialPort_.GetReplayMismatches();
+      BOOST_LOG_TRIVIAL(info) << "Replay mismatches " << mismatches;
+      std::exit(mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 
     void OnConnectionClosed(bool success) {
+      pipeline_.Stop();
+      ReportAllocations();
       if (!success) {
         std::exit(EXIT_FAILURE);
         return;
@@ -91,6 +332,8 @@ namespace
     }
 
     void OnConnectionShut(bool success) {
+      pipeline_.Stop();
+      ReportAllocations();
       if (!success) {
         std::exit(EXIT_FAILURE);
         return;
@@ -107,97 +350,424 @@ namespace
       std::exit(EXIT_FAILURE);
     }
 
-    void StartConnectionCb(bool result) {
+    // Called again after every failover, the connection starts over on another transport.
+    void OnTransportReady(bool result) {
       if (!result) {
         std::exit(EXIT_FAILURE);
         return;
       }
-      std::string data = "{\"ClientType\":\"" + ClientTypeToString(ct_) + "\"}";
-      gprs_.SendData({ data.begin(), data.end() }, std::bind(&App::OnHandshakeSend, this, std::placeholders::_1));
+      if (connected_) {
+        Resume();
+        return;
+      }
+      connected_ = true;
+      codec_.SetType(uplink_.GetCodec());
+      if (config_.probe) {
+        probe_.Start(codec_.GetType());
+      }
+      BOOST_LOG_TRIVIAL(info) << "Negotiated codec: " << TelemetryCodec::TypeToString(codec_.GetType());
+      if (ct_ == ClientType::SUBSCRIBER) {
+        if (!ringWriter_.Open(config_.shmRingName, kShmRingSlots, kShmRingSlotSize)) {
+          BOOST_LOG_TRIVIAL(error) << "Local fan-out disabled";
+        }
+        uplink_.Receive(std::bind(&App::OnData, this, std::placeholders::_1));
+        return;
+      }
+      if (!config_.dutyCycling) {
+        StartPipeline(true);
+        return;
+      }
+      linkScheduler_.Start(std::bind(&App::OnUplinkWindow, this, std::placeholders::_1),
+        std::bind(&App::StartPipeline, this, std::placeholders::_1));
     }
 
-    void OnHandshakeSend(bool result) {
-      if (!result) {
-        BOOST_LOG_TRIVIAL(error) << "Failed to send handshake";
-        gprs_.ShutConnection(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
+    // Fails over or reconnects after a failed send or read, false when the run is over instead.
+    // A replay ends with its trace, the link failing after that is the end of the recording.
+    bool Reconnect() {
+      return gSignalStatus != SIGINT && !serialPort_.IsReplayFinished() && uplink_.FailOver();
+    }
+
+    // The buffer that failed goes out again as it was, a UDP datagram keeps its sequence number.
+    // New frames waited in the backlog meanwhile. A subscriber drops what it had of a frame cut
+    // off by the old connection, the new stream starts on a frame boundary.
+    void Resume() {
+      if (ct_ == ClientType::SUBSCRIBER) {
+        codec_.SetType(uplink_.GetCodec());
+        if (config_.probe) {
+          probe_.OnStreamRestarted();
+        }
+        uplink_.Receive(std::bind(&App::OnData, this, std::placeholders::_1));
         return;
       }
-      gprs_.StartReading(std::bind(&App::OnHandshakeResponse, this, std::placeholders::_1));
+      Send(*inFlight_);
     }
 
-    void OnHandshakeResponse(Gprs::OptionalString result) {
-      if (!result || result.value().find("OK") == std::string::npos) {
-        BOOST_LOG_TRIVIAL(error) << "Failed to handshake";
-        gprs_.ShutConnection(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
-        return;
+    void StartPipeline(bool result) {
+      if (!result || !pipeline_.Start(codec_.GetType(), std::bind(&App::OnFramesReady, this))) {
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
       }
-      if (ct_ == ClientType::SUBSCRIBER) {
-        gprs_.StartReading(std::bind(&App::OnData, this, std::placeholders::_1));
+    }
+
+    void OnUplinkWindow(bool result) {
+      if (!result) {
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
         return;
       }
-      bme280_ = std::make_unique<Bme280>();
-      bme280_->Init();
-      SendData();
+      SendNextFrame();
     }
 
     void OnData(Gprs::OptionalString result) {
       if (!result) {
         BOOST_LOG_TRIVIAL(error) << "Failed to read or connection closed";
-        gprs_.ShutConnection(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
+        if (Reconnect()) {
+          return;
+        }
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
         return;
       }
-      BOOST_LOG_TRIVIAL(info) << "Data: [ " << result.value() << " ]";
+      auto decoded = codec_.Decode(result.value(), [this](const std::vector<char>& frame) {
+        BOOST_LOG_TRIVIAL(info) << "Data: [ " << std::string(frame.begin(), frame.end()) << " ]";
+        // Send stamps are for the probe only, local consumers get telemetry.
+        if (config_.probe && !probe_.OnFrame(frame)) {
+          return;
+        }
+        ringWriter_.Publish(frame.data(), frame.size());
+        });
+      if (!decoded) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to decode data";
+      }
       if (gSignalStatus == SIGINT) {
-        gprs_.CloseTCP(std::bind(&App::OnConnectionClosed, this, std::placeholders::_1));
+        if (config_.probe) {
+          probe_.ReportSubscriber();
+        }
+        if (config_.socket) {
+          uplink_.Report();
+        }
+        uplink_.Close(std::bind(&App::OnConnectionClosed, this, std::placeholders::_1));
+        return;
+      }
+      uplink_.Receive(std::bind(&App::OnData, this, std::placeholders::_1));
+    }
+
+    void OnFramesReady() {
+      auto now = std::chrono::steady_clock::now();
+      TelemetryPipeline::FrameTimes times;
+      while (pipeline_.PopFrame(frame_, times)) {
+        if (config_.probe) {
+          probe_.OnFrameQueued(times.sampledAt, times.encodedAt, now);
+        }
+        if (config_.adaptiveBatching) {
+          batchController_.OnDataQueued(frame_.size(), now);
+        }
+        if (backlog_.Push(frame_.data(), frame_.size(), now) > 0) {
+          BOOST_LOG_TRIVIAL(warning) << "Backlog full, oldest frame dropped";
+        }
+      }
+      if (bonding_) {
+        bonding_->Dispatch();
         return;
       }
-      gprs_.StartReading(std::bind(&App::OnData, this, std::placeholders::_1));
+      if (config_.dutyCycling && !linkScheduler_.IsWindowOpen()) {
+        linkScheduler_.OnDataQueued();
+        return;
+      }
+      if (!sending_) {
+        SendNextFrame();
+      }
+    }
+
+    bool FlushDue() {
+      if (!config_.adaptiveBatching || linkScheduler_.IsWindowOpen() || gSignalStatus == SIGINT || backlog_.IsEmpty()) {
+        return true;
+      }
+      return backlog_.GetBytes() >= batchController_.GetBatchSize() ||
+        std::chrono::steady_clock::now() - backlog_.GetFrontQueuedAt() >= batchController_.GetFlushInterval();
+    }
+
+    // Coalesces queued frames, codec frames are self delimiting so they can share one send.
+    bool PopBatch(std::vector<char>& batch) {
+      auto maxBatchSize = config_.adaptiveBatching ? batchController_.GetBatchSize() : kMaxBatchSize;
+      // Only plain TCP sends are segmented, bonded links and probe stamps work with single CIPSENDs.
+      bool bulk = !config_.adaptiveBatching && !config_.probe && !bonding_ &&
+        config_.connectionType == Gprs::ConnectionType::TCP && backlog_.GetBytes() > kMaxBatchSize;
+      if (bulk) {
+        maxBatchSize = kMaxBulkBatchSize;
+      }
+      batch.clear();
+      auto now = std::chrono::steady_clock::now();
+      while (!backlog_.IsEmpty() && (batch.empty() || batch.size() + backlog_.GetFrontSize() <= maxBatchSize)) {
+        if (config_.probe) {
+          probe_.OnFrameDequeued(backlog_.GetFrontQueuedAt(), now);
+        }
+        backlog_.PopFront(batch);
+      }
+      return !batch.empty();
+    }
+
+    // data has to stay untouched until the send completed, it is sent again after a failover.
+    void Send(const std::vector<char>& data) {
+      inFlight_ = &data;
+      sendStartedAt_ = std::chrono::steady_clock::now();
+      sentBytes_ = data.size();
+      // Capturing only this keeps the callback inline in std::function, a bind would be heap allocated.
+      uplink_.Send(data, [this](bool result) { OnDataSend(result); });
+    }
+
+    void SendNextFrame() {
+      sending_ = true;
+      if (FlushDue() && PopBatch(frame_)) {
+        if (config_.connectionType == Gprs::ConnectionType::UDP) {
+          Send(udpSession_.Wrap(frame_));
+          return;
+        }
+        Send(config_.probe ? probe_.StampBatch(frame_) : frame_);
+        return;
+      }
+      // Fresh samples go first, retransmissions use the idle link time.
+      if (config_.connectionType == Gprs::ConnectionType::UDP && udpSession_.NextRetransmit(retransmit_)) {
+        Send(retransmit_);
+        return;
+      }
+      if (config_.adaptiveBatching && std::chrono::steady_clock::now() >= nextLinkQualityAt_) {
+        SampleLinkQuality();
+        return;
+      }
+      sending_ = false;
+      if (config_.dutyCycling) {
+        linkScheduler_.CloseWindow();
+        return;
+      }
+      if (config_.adaptiveBatching && !backlog_.IsEmpty()) {
+        auto flushIn = backlog_.GetFrontQueuedAt() + batchController_.GetFlushInterval() - std::chrono::steady_clock::now();
+        flushTimeout_.expires_from_now(std::max(flushIn, std::chrono::steady_clock::duration::zero()));
+        flushTimeout_.async_wait(std::bind(&App::OnFlushTimeout, this, std::placeholders::_1));
+      }
+    }
+
+    void OnFlushTimeout(const boost::system::error_code& error) {
+      if (!error && !sending_) {
+        SendNextFrame();
+      }
+    }
+
+    // Runs in an idle command slot, so it never delays queued data.
+    void SampleLinkQuality() {
+      gprs_.GetSignalQuality([this](std::experimental::optional<int> rssi) {
+        gprs_.GetRegistrationStatus([this, rssi](std::experimental::optional<int> status) {
+          nextLinkQualityAt_ = std::chrono::steady_clock::now() + kLinkQualityInterval;
+          // 1 - registered home network, 5 - registered roaming
+          bool registered = status && (status.value() == 1 || status.value() == 5);
+          auto decision = batchController_.OnLinkQuality(rssi ? rssi.value() : 99, registered);
+          ReportBatchMetrics("link quality", decision);
+          SendNextFrame();
+          });
+        });
     }
 
-    void SendData() {
-      auto sensorsData = bme280_->ReadSensorsData();
-      std::ostringstream oss;
-      oss
-        << "{\"humidity\": " << sensorsData.humidity << ", "
-        << "\"temperature\": " << sensorsData.temperature << ", "
-        << "\"pressure\": " << sensorsData.pressure / 100.0 << "}";
-      std::string data = oss.str();
-      BOOST_LOG_TRIVIAL(info) << "Data: [ " << data << " ]";
-      gprs_.SendData({ data.begin(), data.end() }, std::bind(&App::OnDataSend, this, std::placeholders::_1));
+    void ReportBatchMetrics(const char* trigger, BatchController::Decision decision) {
+      const auto& metrics = batchController_.GetMetrics();
+      BOOST_LOG_TRIVIAL(info) << "Batch control (" << trigger << "): " << BatchController::DecisionToString(decision)
+        << ", batch " << metrics.batchSize << " bytes, flush " << metrics.flushInterval.count() << " ms"
+        << ", goodput " << metrics.goodputBps << " B/s, arrival " << metrics.arrivalBps << " B/s"
+        << ", latency " << metrics.fixedLatencyMs << " ms + " << metrics.perByteMs << " ms/B"
+        << ", rssi " << metrics.rssi << (metrics.registered ? "" : " unregistered")
+        << ", failures " << metrics.failures << "/" << metrics.sends;
     }
 
     void OnDataSend(bool result) {
+      if (config_.adaptiveBatching) {
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sendStartedAt_);
+        auto decision = batchController_.OnSendCompleted(sentBytes_, latency, result);
+        ReportBatchMetrics("send", decision);
+      }
+      if (config_.probe) {
+        probe_.OnSendCompleted(std::chrono::steady_clock::now() - sendStartedAt_, result);
+      }
       if (!result) {
         BOOST_LOG_TRIVIAL(error) << "Failed to send data";
-        gprs_.ShutConnection(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
+        if (Reconnect()) {
+          return;
+        }
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
         return;
       }
+      if (config_.dutyCycling) {
+        linkScheduler_.OnDataSent();
+      }
+      if (++completedSends_ == kWarmupSends && ct_ == ClientType::PUBLISHER) {
+        EnterSteadyState();
+      }
       if (gSignalStatus == SIGINT) {
-        gprs_.ShutConnection(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
+        ReportAllocations();
+        if (config_.connectionType == Gprs::ConnectionType::UDP) {
+          ReportUdpCounters();
+        }
+        ReportPipelineCounters();
+        if (config_.probe) {
+          probe_.ReportPublisher();
+        }
+        if (config_.socket) {
+          uplink_.Report();
+        }
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
         return;
       }
       if (ct_ == ClientType::SUBSCRIBER) {
-        gprs_.StartReading(std::bind(&App::OnData, this, std::placeholders::_1));
+        uplink_.Receive(std::bind(&App::OnData, this, std::placeholders::_1));
         return;
       }
-      using namespace std::chrono_literals;
-      timeout_.expires_from_now(5s);
-      timeout_.async_wait(std::bind(&App::OnTimeout, this, std::placeholders::_1));
+      if (config_.connectionType == Gprs::ConnectionType::UDP && gprs_.HasIncomingData()) {
+        readingAck_ = true;
+        ackTimeout_.expires_from_now(kAckReadTimeout);
+        ackTimeout_.async_wait(std::bind(&App::OnAckTimeout, this, std::placeholders::_1));
+        uplink_.Receive(std::bind(&App::OnAck, this, std::placeholders::_1));
+        return;
+      }
+      SendNextFrame();
+    }
+
+    void OnBondingReady(TelemetryCodec::Type codec) {
+      codec_.SetType(codec);
+      BOOST_LOG_TRIVIAL(info) << "Negotiated codec: " << TelemetryCodec::TypeToString(codec_.GetType());
+      if (!pipeline_.Start(codec_.GetType(), std::bind(&App::OnFramesReady, this))) {
+        std::exit(EXIT_FAILURE);
+      }
     }
 
-    void OnTimeout(const boost::system::error_code& error) {
-      if (!error) {
-        SendData();
+    void OnBondedSend() {
+      if (gSignalStatus == SIGINT) {
+        ShutdownBonding();
       }
     }
 
+    void WatchForSignal() {
+      signalTimeout_.expires_from_now(kSignalCheckInterval);
+      signalTimeout_.async_wait(std::bind(&App::OnSignalTimeout, this, std::placeholders::_1));
+    }
+
+    void OnSignalTimeout(const boost::system::error_code& error) {
+      if (error || shuttingDown_) {
+        return;
+      }
+      if (gSignalStatus == SIGINT) {
+        ShutdownBonding();
+        return;
+      }
+      WatchForSignal();
+    }
+
+    // Sends in flight complete first, links still connecting are closed as they are.
+    void ShutdownBonding() {
+      if (shuttingDown_) {
+        return;
+      }
+      shuttingDown_ = true;
+      signalTimeout_.cancel();
+      ReportPipelineCounters();
+      bonding_->Report();
+      bonding_->Shutdown(std::bind(&App::OnBondingShutdown, this));
+    }
+
+    void OnBondingShutdown() {
+      pipeline_.Stop();
+      std::exit(EXIT_SUCCESS);
+    }
+
+    void OnAck(Gprs::OptionalString result) {
+      if (!readingAck_) {
+        return;
+      }
+      readingAck_ = false;
+      ackTimeout_.cancel();
+      if (!result) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to read ack or connection closed";
+        uplink_.Close(std::bind(&App::OnConnectionShut, this, std::placeholders::_1));
+        return;
+      }
+      if (udpSession_.OnAck(result.value())) {
+        ReportUdpCounters();
+      }
+      SendNextFrame();
+    }
+
+    // Acks only speed up retransmissions, a missing one must not stall the samples.
+    void OnAckTimeout(const boost::system::error_code& error) {
+      if (error || !readingAck_) {
+        return;
+      }
+      readingAck_ = false;
+      BOOST_LOG_TRIVIAL(warning) << "Ack read timed out";
+      uplink_.CancelReceive();
+      SendNextFrame();
+    }
+
+    // From here on the publisher loop runs on preallocated storage only.
+    void EnterSteadyState() {
+      if (!AllocationGuard::IsEnabled()) {
+        return;
+      }
+      BOOST_LOG_TRIVIAL(info) << "Steady state reached after " << AllocationGuard::GetTotalAllocations()
+        << " heap allocations, logging below warning is off from now on";
+      // Every log record costs a heap allocation, records filtered out by severity don't.
+      boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+      AllocationGuard::EnterSteadyState(config_.failOnAllocation);
+    }
+
+    void ReportAllocations() {
+      if (!AllocationGuard::IsEnabled()) {
+        return;
+      }
+      AllocationGuard::LeaveSteadyState();
+      boost::log::core::get()->reset_filter();
+      BOOST_LOG_TRIVIAL(info) << "Heap allocations " << AllocationGuard::GetTotalAllocations()
+        << ", in steady state " << AllocationGuard::GetSteadyStateAllocations();
+    }
+
+    void ReportPipelineCounters() {
+      const auto& counters = pipeline_.GetCounters();
+      BOOST_LOG_TRIVIAL(info) << "Pipeline raw samples " << counters.rawSamples << ", dropped raw samples " << counters.droppedRawSamples
+        << ", samples " << counters.samples << ", dropped samples " << counters.droppedSamples
+        << ", frames " << counters.frames << ", dropped frames " << counters.droppedFrames;
+    }
+
+    void ReportUdpCounters() {
+      const auto& counters = udpSession_.GetCounters();
+      BOOST_LOG_TRIVIAL(info) << "UDP sent " << counters.sent << ", acked " << counters.acked
+        << ", loss detected " << counters.lossDetected << ", retransmitted " << counters.retransmitted
+        << ", abandoned " << counters.abandoned << ", acks " << counters.acksReceived;
+    }
+
     boost::system::error_code ec_;
     boost::asio::io_service ioService_;
     ExtendedSerialPort serialPort_;
     Gprs gprs_;
     ClientType ct_;
-    Timeout timeout_;
-    std::unique_ptr<Bme280> bme280_;
+    AppConfig config_;
+    TelemetryCodec codec_;
+    std::vector<char> frame_;
+    UdpSession udpSession_;
+    std::vector<char> retransmit_;
+    // frame_, retransmit_ or what UdpSession or LatencyProbe made of frame_.
+    const std::vector<char>* inFlight_ = nullptr;
+    bool sending_ = false;
+    FrameRing backlog_;
+    std::chrono::steady_clock::time_point sendStartedAt_;
+    std::size_t sentBytes_ = 0;
+    std::size_t completedSends_ = 0;
+    std::chrono::steady_clock::time_point nextLinkQualityAt_;
+    BatchController batchController_;
+    TelemetryPipeline pipeline_;
+    ShmRingWriter ringWriter_;
+    LinkScheduler linkScheduler_;
+    Timeout flushTimeout_;
+    Timeout ackTimeout_;
+    bool readingAck_ = false;
+    std::unique_ptr<LinkBonding> bonding_;
+    Timeout signalTimeout_;
+    bool shuttingDown_ = false;
+    LatencyProbe probe_;
+    TransportPolicy uplink_;
+    bool connected_ = false;
   };
 
 } // namespace
@@ -219,12 +789,12 @@ int main(int argc, char* argv[])
   //   << "."
   //   << BOOST_VERSION % 100
   //   << std::endl;
-  if (argc != 2) {
-    BOOST_LOG_TRIVIAL(fatal) << "Wrong number of parameters";
+  AppConfig config;
+  if (!ParseArguments(argc, argv, config)) {
     return EXIT_FAILURE;
   }
   std::signal(SIGINT, signalHandler);
-  App app(DeduceClientType(argv[1]));
+  App app(config);
   app.DoStuff();
 
   return EXIT_SUCCESS;
@@ -0,0 +1,195 @@
+#include "modemLink.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <memory>
+
+#include "gprsTransport.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  constexpr std::chrono::seconds kInitialBackoff = 5s;
+  constexpr std::chrono::seconds kMaxBackoff = 60s;
+  // A server that doesn't answer the handshake within this takes the link down.
+  constexpr std::chrono::seconds kHandshakeTimeout = 10s;
+
+  TransportPolicy::Config MakeUplinkConfig(const ModemLink::Config& config) {
+    TransportPolicy::Config uplinkConfig;
+    uplinkConfig.clientType = ClientProtocol::ClientType::PUBLISHER;
+    uplinkConfig.offeredCodec = config.offeredCodec;
+    uplinkConfig.serverAddress = config.serverAddress;
+    uplinkConfig.serverPort = config.serverPort;
+    uplinkConfig.handshakeTimeout = kHandshakeTimeout;
+    uplinkConfig.retryInterval = kInitialBackoff;
+    uplinkConfig.maxRetryInterval = kMaxBackoff;
+    return uplinkConfig;
+  }
+  // Assumed until the first send completes, about what a SIM800 does on a fair GPRS signal.
+  constexpr double kInitialGoodputBps = 1000.0;
+  constexpr double kGoodputSmoothing = 0.25;
+}
+
+ModemLink::ModemLink(boost::asio::io_service& ioService, const Config& config) : ioService_(ioService),
+config_(config),
+serialPort_(ioService),
+gprs_(serialPort_),
+uplink_(ioService, MakeUplinkConfig(config)),
+reconnectTimeout_(ioService),
+backoff_(kInitialBackoff) {
+  stats_.goodputBps = kInitialGoodputBps;
+  uplink_.Add(std::make_unique<GprsTransport>(gprs_, GprsTransport::Config{ config.apnName, Gprs::ConnectionType::TCP }));
+}
+
+void ModemLink::Start(StateChangedCallback stateChanged) {
+  stateChangedCb_ = std::move(stateChanged);
+  Connect();
+}
+
+void ModemLink::Send(const std::vector<char>& batch, Gprs::BoolResultCallback cb) {
+  sendCb_ = std::move(cb);
+  sentBytes_ = batch.size();
+  sendStartedAt_ = Clock::now();
+  // Busy is not a link state change, the owner learns about it from the send callback.
+  state_ = State::SENDING;
+  uplink_.Send(batch, std::bind(&ModemLink::OnDataSend, this, std::placeholders::_1));
+}
+
+void ModemLink::Close(Gprs::BoolResultCallback cb) {
+  closing_ = true;
+  reconnectTimeout_.cancel();
+  SetState(State::DOWN);
+  uplink_.Close(std::move(cb));
+}
+
+ModemLink::State ModemLink::GetState() const {
+  return state_;
+}
+
+bool ModemLink::IsUp() const {
+  return state_ == State::READY || state_ == State::SENDING;
+}
+
+TelemetryCodec::Type ModemLink::GetCodec() const {
+  return codec_;
+}
+
+ModemLink::Clock::duration ModemLink::EstimateCompletion(std::size_t bytes) const {
+  auto sendTime = [this](std::size_t size) {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(size / stats_.goodputBps));
+  };
+  auto estimate = sendTime(bytes);
+  if (state_ == State::SENDING) {
+    estimate += std::max(sendTime(sentBytes_) - (Clock::now() - sendStartedAt_), Clock::duration::zero());
+  }
+  return estimate;
+}
+
+const ModemLink::Config& ModemLink::GetConfig() const {
+  return config_;
+}
+
+const ModemLink::Stats& ModemLink::GetStats() const {
+  return stats_;
+}
+
+std::string ModemLink::StateToString(State state) {
+  switch (state) {
+  case State::DOWN:
+    return "DOWN";
+  case State::CONNECTING:
+    return "CONNECTING";
+  case State::READY:
+    return "READY";
+  case State::SENDING:
+    return "SENDING";
+  }
+  return "";
+}
+
+void ModemLink::SetState(State state) {
+  if (state_ == state) {
+    return;
+  }
+  BOOST_LOG_TRIVIAL(info) << "Modem " << config_.name << ": " << StateToString(state_) << " -> " << StateToString(state);
+  state_ = state;
+  stateChangedCb_(*this);
+}
+
+void ModemLink::Connect() {
+  if (closing_) {
+    return;
+  }
+  SetState(State::CONNECTING);
+  if (!serialPort_.is_open()) {
+    boost::system::error_code ec;
+    serialPort_.open(config_.device, ec);
+    if (ec) {
+      Fail("serial port open failed");
+      return;
+    }
+    serialPort_.set_option(boost::asio::serial_port::baud_rate(115200));
+  }
+  // Once connected the policy reconnects by itself, only a failed first connect comes back here.
+  uplink_.Start(std::bind(&ModemLink::OnReady, this, std::placeholders::_1));
+}
+
+// Also called after every reconnect the policy made on its own.
+void ModemLink::OnReady(bool result) {
+  if (closing_) {
+    return;
+  }
+  if (!result) {
+    Fail("connection failed");
+    return;
+  }
+  codec_ = uplink_.GetCodec();
+  BOOST_LOG_TRIVIAL(info) << "Modem " << config_.name << ": negotiated codec " << TelemetryCodec::TypeToString(codec_);
+  backoff_ = kInitialBackoff;
+  SetState(State::READY);
+}
+
+void ModemLink::OnDataSend(bool result) {
+  auto latency = std::chrono::duration<double>(Clock::now() - sendStartedAt_).count();
+  ++stats_.sends;
+  if (result) {
+    stats_.bytes += sentBytes_;
+    auto goodput = sentBytes_ / std::max(latency, 0.001);
+    stats_.goodputBps += kGoodputSmoothing * (goodput - stats_.goodputBps);
+    state_ = State::READY;
+    sendCb_(true);
+    return;
+  }
+  ++stats_.failures;
+  // The time lost on a failed send counts against the link as if nothing got through.
+  stats_.goodputBps *= 1.0 - kGoodputSmoothing;
+  auto cb = std::move(sendCb_);
+  cb(false);
+  BOOST_LOG_TRIVIAL(error) << "Modem " << config_.name << " (" << config_.device << "): failed to send data";
+  SetState(State::DOWN);
+  if (uplink_.FailOver()) {
+    ++stats_.reconnects;
+  }
+}
+
+void ModemLink::Fail(const char* reason) {
+  BOOST_LOG_TRIVIAL(error) << "Modem " << config_.name << " (" << config_.device << "): " << reason
+    << ", reconnecting in " << backoff_.count() << " s";
+  SetState(State::DOWN);
+  if (closing_) {
+    return;
+  }
+  reconnectTimeout_.expires_from_now(backoff_);
+  reconnectTimeout_.async_wait(std::bind(&ModemLink::OnReconnectTimeout, this, std::placeholders::_1));
+  backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+}
+
+void ModemLink::OnReconnectTimeout(const boost::system::error_code& error) {
+  if (error || closing_) {
+    return;
+  }
+  ++stats_.reconnects;
+  Connect();
+}
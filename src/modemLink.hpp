@@ -0,0 +1,99 @@
+#ifndef MODEM_LINK_HPP
+#define MODEM_LINK_HPP
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/high_resolution_timer.hpp>
+
+#include "extendedSerialPort.hpp"
+#include "gprs.hpp"
+#include "telemetryCodec.hpp"
+#include "transportPolicy.hpp"
+
+// One SIM800 on its own serial device, with its own Gprs state machine and TCP session to the
+// server. Start() brings the link up (init, join, connect, PUBLISHER handshake) and keeps it up:
+// any failure takes the link DOWN and it reconnects with exponential backoff. Connect, handshake
+// and reconnects are a TransportPolicy over the modem's only transport. Every send updates the
+// measured goodput, which LinkBonding uses to spread batches across links.
+class ModemLink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State {
+        DOWN,
+        CONNECTING,
+        READY,
+        SENDING,
+    };
+
+    using StateChangedCallback = std::function<void(ModemLink& link)>;
+
+    struct Config {
+        std::string name;
+        std::string device;
+        std::string apnName;
+        std::string serverAddress;
+        std::size_t serverPort = 0;
+        TelemetryCodec::Type offeredCodec = TelemetryCodec::Type::NONE;
+    };
+
+    struct Stats {
+        std::size_t sends = 0;
+        std::size_t failures = 0;
+        std::size_t bytes = 0;
+        std::size_t reconnects = 0;
+        // Smoothed payload bytes per second of the completed sends, latency included.
+        double goodputBps = 0.0;
+    };
+
+    ModemLink(boost::asio::io_service& ioService, const Config& config);
+
+    void Start(StateChangedCallback stateChanged);
+    // Only while READY. cb runs while the link still counts as busy, before a failure takes it
+    // DOWN, so a failed batch can be handed to another link straight away.
+    void Send(const std::vector<char>& batch, Gprs::BoolResultCallback cb);
+    void Close(Gprs::BoolResultCallback cb);
+
+    State GetState() const;
+    bool IsUp() const;
+    TelemetryCodec::Type GetCodec() const;
+    // Estimated time the link needs to complete a send of bytes, plus whatever is in flight.
+    Clock::duration EstimateCompletion(std::size_t bytes) const;
+    const Config& GetConfig() const;
+    const Stats& GetStats() const;
+
+    static std::string StateToString(State state);
+
+private:
+    void SetState(State state);
+    void Connect();
+    void OnReady(bool result);
+    void OnDataSend(bool result);
+    void Fail(const char* reason);
+    void OnReconnectTimeout(const boost::system::error_code& error);
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    boost::asio::io_service& ioService_;
+    Config config_;
+    ExtendedSerialPort serialPort_;
+    Gprs gprs_;
+    TransportPolicy uplink_;
+    Timeout reconnectTimeout_;
+    State state_ = State::DOWN;
+    bool closing_ = false;
+    std::chrono::seconds backoff_;
+    TelemetryCodec::Type codec_ = TelemetryCodec::Type::NONE;
+    StateChangedCallback stateChangedCb_;
+    Gprs::BoolResultCallback sendCb_;
+    std::size_t sentBytes_ = 0;
+    Clock::time_point sendStartedAt_;
+    Stats stats_;
+};
+
+#endif // MODEM_LINK_HPP
@@ -0,0 +1,76 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock free queue for many producers and one consumer thread
+// (Vyukov's per cell sequence scheme). All storage is allocated up front.
+template<typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(std::size_t capacity) : cells_(RoundUp(capacity)), mask_(cells_.size() - 1) {
+        for (std::size_t i = 0; i < cells_.size(); ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    bool TryPush(T value) {
+        auto pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T& value) {
+        auto& cell = cells_[dequeuePos_ & mask_];
+        auto sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos_ + 1) {
+            return false;
+        }
+        value = std::move(cell.value);
+        cell.sequence.store(dequeuePos_ + cells_.size(), std::memory_order_release);
+        ++dequeuePos_;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence{ 0 };
+        T value;
+    };
+
+    static std::size_t RoundUp(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+private:
+    std::vector<Cell> cells_;
+    const std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> enqueuePos_{ 0 };
+    alignas(64) std::size_t dequeuePos_ = 0;
+};
+
+#endif // MPSC_QUEUE_HPP
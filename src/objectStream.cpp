@@ -0,0 +1,46 @@
+#include "objectStream.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+void ObjectStream::Feed(const std::vector<char>& chunk, const TelemetryCodec::FrameCallback& cb) {
+  pending_.insert(pending_.end(), chunk.begin(), chunk.end());
+  auto begin = pending_.begin();
+  while (true) {
+    begin = std::find(begin, pending_.end(), '{');
+    auto end = std::find(begin, pending_.end(), '}');
+    if (end == pending_.end()) {
+      break;
+    }
+    object_.assign(begin, end + 1);
+    cb(object_);
+    begin = end + 1;
+  }
+  pending_.erase(pending_.begin(), begin);
+}
+
+void ObjectStream::Reset() {
+  pending_.clear();
+}
+
+bool FindIntegerField(const std::vector<char>& frame, const char* name, std::int64_t& value) {
+  std::string key = std::string("\"") + name + "\"";
+  auto end = frame.end();
+  auto field = std::search(frame.begin(), end, key.begin(), key.end());
+  if (field == end) {
+    return false;
+  }
+  auto colon = std::find_if_not(field + key.size(), end, [](char c) { return c == ' '; });
+  if (colon == end || *colon != ':') {
+    return false;
+  }
+  // strtoll needs a terminated string, integers are short.
+  char digits[24] = {};
+  auto start = colon + 1;
+  std::copy(start, start + std::min<std::ptrdiff_t>(end - start, sizeof(digits) - 1), digits);
+  char* parsedEnd = nullptr;
+  value = std::strtoll(digits, &parsedEnd, 10);
+  return parsedEnd != digits;
+}
@@ -0,0 +1,26 @@
+#ifndef OBJECT_STREAM_HPP
+#define OBJECT_STREAM_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "telemetryCodec.hpp"
+
+// Uncompressed streams carry no framing, chunks split and join samples anywhere. Cuts them back
+// into the flat JSON objects the clients send.
+class ObjectStream {
+public:
+    void Feed(const std::vector<char>& chunk, const TelemetryCodec::FrameCallback& cb);
+    // Drops a partial object, the next chunk starts a new stream.
+    void Reset();
+
+private:
+    std::vector<char> pending_;
+    std::vector<char> object_;
+};
+
+// Integer value of "name" in the flat JSON object frame, false when it isn't there.
+bool FindIntegerField(const std::vector<char>& frame, const char* name, std::int64_t& value);
+
+#endif // OBJECT_STREAM_HPP
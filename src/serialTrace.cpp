@@ -0,0 +1,248 @@
+#include "serialTrace.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "allocationGuard.hpp"
+
+
+namespace
+{
+  constexpr char kMagic[4] = { 'R', 'P', 'S', 'T' };
+  constexpr uint16_t kVersion = 1;
+
+  uint64_t MonotonicNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+  }
+
+  template<typename T>
+  bool ReadValue(std::ifstream& file, T& value) {
+    return bool(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+  }
+
+  template<typename T>
+  void WriteValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+}
+
+namespace SerialTrace
+{
+
+bool Writer::Open(const std::string& path) {
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to open serial trace " << path;
+    return false;
+  }
+  file_.write(kMagic, sizeof(kMagic));
+  WriteValue(file_, kVersion);
+  return bool(file_);
+}
+
+void Writer::Record(Direction direction, const void* data, std::size_t size) {
+  auto now = MonotonicNs();
+  if (!started_) {
+    started_ = true;
+    startNs_ = now;
+  }
+  WriteValue(file_, now - startNs_);
+  WriteValue(file_, static_cast<uint8_t>(direction));
+  WriteValue(file_, static_cast<uint32_t>(size));
+  file_.write(static_cast<const char*>(data), size);
+  // Traces matter most when the process dies, don't keep records buffered.
+  file_.flush();
+}
+
+bool Load(const std::string& path, std::vector<Record>& records) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  uint16_t version = 0;
+  if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+    !ReadValue(file, version) || version != kVersion) {
+    BOOST_LOG_TRIVIAL(error) << "Not a serial trace: " << path;
+    return false;
+  }
+  records.clear();
+  Record record;
+  uint8_t direction = 0;
+  uint32_t length = 0;
+  while (ReadValue(file, record.timestampNs) && ReadValue(file, direction) && ReadValue(file, length)) {
+    record.direction = static_cast<Direction>(direction);
+    record.data.resize(length);
+    if (!file.read(record.data.data(), length)) {
+      BOOST_LOG_TRIVIAL(warning) << "Serial trace truncated after " << records.size() << " records";
+      break;
+    }
+    records.push_back(record);
+  }
+  return true;
+}
+
+Replay::Replay(boost::asio::io_service& ioService, bool asFastAsPossible, FinishedHandler onFinished) : ioService_(ioService),
+asFastAsPossible_(asFastAsPossible),
+onFinished_(std::move(onFinished)),
+timeout_(ioService) {}
+
+bool Replay::Load(const std::string& path) {
+  if (!SerialTrace::Load(path, records_)) {
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "Replaying " << records_.size() << " serial records from " << path
+    << (asFastAsPossible_ ? " as fast as possible" : " at recorded speed");
+  startedAt_ = Clock::now();
+  lastRxAt_ = startedAt_;
+  anchor_ = startedAt_;
+  // Anything the modem said before the first command is timed from the start of the trace.
+  ScheduleUntilNextTx(records_.empty() ? 0 : records_.front().timestampNs);
+  return true;
+}
+
+std::size_t Replay::Write(const void* data, std::size_t size) {
+  auto now = Clock::now();
+  // The build under test may answer sooner than the recorded one, deliver what preceded this TX now.
+  while (next_ < scheduledUntil_) {
+    Release(next_++);
+  }
+  if (next_ < records_.size() && records_[next_].direction == Direction::TX) {
+    const auto& expected = records_[next_].data;
+    if (expected.size() != size || std::memcmp(expected.data(), data, size) != 0) {
+      ++mismatches_;
+      BOOST_LOG_TRIVIAL(warning) << "Replay TX differs from trace: [ " << std::string(static_cast<const char*>(data), size)
+        << " ] vs [ " << std::string(expected.begin(), expected.end()) << " ]";
+    }
+    auto reaction = now - lastRxAt_;
+    reactionTotal_ += reaction;
+    reactionMax_ = std::max(reactionMax_, reaction);
+    ++txCount_;
+    anchor_ = now;
+    anchorNs_ = records_[next_].timestampNs;
+    ++next_;
+    ScheduleUntilNextTx(anchorNs_);
+  }
+  else if (!finished_) {
+    // A recording stops in the middle of the session, the app going on past it is not a mismatch.
+    BOOST_LOG_TRIVIAL(info) << "Replay TX past the end of the trace: [ " << std::string(static_cast<const char*>(data), size) << " ]";
+    Finish();
+  }
+  Deliver();
+  return size;
+}
+
+void Replay::AsyncRead(boost::asio::mutable_buffer buffer, ReadHandler handler) {
+  readPending_ = true;
+  readBuffer_ = buffer;
+  readHandler_ = std::move(handler);
+  Deliver();
+}
+
+void Replay::Cancel() {
+  if (!readPending_) {
+    return;
+  }
+  readPending_ = false;
+  ioService_.post(std::bind(std::move(readHandler_), boost::system::error_code(boost::asio::error::operation_aborted), 0));
+}
+
+bool Replay::IsDataAvailable() const {
+  return !ready_.empty();
+}
+
+bool Replay::IsFinished() const {
+  return finished_;
+}
+
+std::size_t Replay::GetMismatches() const {
+  return mismatches_;
+}
+
+void Replay::ScheduleUntilNextTx(uint64_t anchorNs) {
+  anchorNs_ = anchorNs;
+  scheduledUntil_ = next_;
+  while (scheduledUntil_ < records_.size() && records_[scheduledUntil_].direction == Direction::RX) {
+    ++scheduledUntil_;
+  }
+  ArmTimer();
+}
+
+void Replay::ArmTimer() {
+  if (next_ == scheduledUntil_) {
+    return;
+  }
+  auto delay = std::chrono::nanoseconds(records_[next_].timestampNs - anchorNs_);
+  if (asFastAsPossible_ || records_[next_].timestampNs < anchorNs_) {
+    delay = std::chrono::nanoseconds::zero();
+  }
+  timeout_.expires_from_now(anchor_ + delay - Clock::now());
+  timeout_.async_wait(std::bind(&Replay::OnTimeout, this, std::placeholders::_1));
+}
+
+void Replay::OnTimeout(const boost::system::error_code& error) {
+  if (error) {
+    return;
+  }
+  AllocationGuard::ScopedExemption exemption;
+  auto now = Clock::now();
+  while (next_ < scheduledUntil_ &&
+    (asFastAsPossible_ || anchor_ + std::chrono::nanoseconds(records_[next_].timestampNs - anchorNs_) <= now)) {
+    Release(next_++);
+  }
+  Deliver();
+  ArmTimer();
+}
+
+void Replay::Release(std::size_t index) {
+  const auto& data = records_[index].data;
+  ready_.insert(ready_.end(), data.begin(), data.end());
+  lastRxAt_ = Clock::now();
+  ++rxCount_;
+}
+
+void Replay::Deliver() {
+  if (!readPending_) {
+    return;
+  }
+  if (!ready_.empty()) {
+    auto size = std::min(ready_.size(), readBuffer_.size());
+    std::copy(ready_.begin(), ready_.begin() + size, static_cast<char*>(readBuffer_.data()));
+    ready_.erase(ready_.begin(), ready_.begin() + size);
+    readPending_ = false;
+    ioService_.post(std::bind(std::move(readHandler_), boost::system::error_code(), size));
+    return;
+  }
+  if (next_ == records_.size()) {
+    readPending_ = false;
+    Finish();
+    ioService_.post(std::bind(std::move(readHandler_), boost::system::error_code(boost::asio::error::eof), 0));
+  }
+}
+
+// The app decides what the end of the trace means for it, onFinished runs before any read fails.
+void Replay::Finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  Report();
+  if (onFinished_) {
+    ioService_.post(onFinished_);
+  }
+}
+
+void Replay::Report() {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  auto recordedNs = records_.empty() ? 0 : records_.back().timestampNs;
+  BOOST_LOG_TRIVIAL(info) << "Replay finished: " << txCount_ << " TX, " << rxCount_ << " RX, " << mismatches_ << " mismatches"
+    << ", wall time " << duration_cast<microseconds>(Clock::now() - startedAt_).count() << " us"
+    << " for " << recordedNs / 1000 << " us recorded"
+    << ", RX to TX reaction avg " << (txCount_ ? duration_cast<microseconds>(reactionTotal_).count() / txCount_ : 0) << " us"
+    << " max " << duration_cast<microseconds>(reactionMax_).count() << " us";
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef SERIAL_TRACE_HPP
+#define SERIAL_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/high_resolution_timer.hpp>
+#include <boost/asio/io_service.hpp>
+
+// Binary trace of the modem serial traffic, host byte order:
+//   file:   "RPST" | version (u16)
+//   record: CLOCK_MONOTONIC ns since the first record (u64) | direction (u8) | length (u32) | bytes
+namespace SerialTrace
+{
+    enum class Direction : uint8_t {
+        RX = 0,
+        TX = 1,
+    };
+
+    struct Record {
+        uint64_t timestampNs;
+        Direction direction;
+        std::vector<char> data;
+    };
+
+    class Writer {
+    public:
+        bool Open(const std::string& path);
+        void Record(Direction direction, const void* data, std::size_t size);
+
+    private:
+        std::ofstream file_;
+        bool started_ = false;
+        uint64_t startNs_ = 0;
+    };
+
+    bool Load(const std::string& path, std::vector<Record>& records);
+
+    // Plays a trace back in place of the serial port. Every TX is matched against the next
+    // recorded TX, the RX records following it are delivered with their recorded delay
+    // relative to it, or immediately when running as fast as possible. The replay is finished
+    // when the app writes past the last TX or reads past the last RX, onFinished is posted then
+    // and reads fail with eof after it.
+    class Replay {
+    public:
+        using ReadHandler = std::function<void(const boost::system::error_code&, std::size_t)>;
+        using FinishedHandler = std::function<void()>;
+
+        Replay(boost::asio::io_service& ioService, bool asFastAsPossible, FinishedHandler onFinished = nullptr);
+        bool Load(const std::string& path);
+        std::size_t Write(const void* data, std::size_t size);
+        void AsyncRead(boost::asio::mutable_buffer buffer, ReadHandler handler);
+        // Completes a pending read with operation_aborted, like cancel() on the port.
+        void Cancel();
+        bool IsDataAvailable() const;
+        // Every record was played.
+        bool IsFinished() const;
+        std::size_t GetMismatches() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        using Timeout = boost::asio::high_resolution_timer;
+
+        void ScheduleUntilNextTx(uint64_t anchorNs);
+        void ArmTimer();
+        void OnTimeout(const boost::system::error_code& error);
+        void Release(std::size_t index);
+        void Deliver();
+        void Finish();
+        void Report();
+
+    private:
+        boost::asio::io_service& ioService_;
+        bool asFastAsPossible_;
+        FinishedHandler onFinished_;
+        Timeout timeout_;
+        std::vector<Record> records_;
+        // Records before next_ are consumed, [next_, scheduledUntil_) are RX waiting for their time.
+        std::size_t next_ = 0;
+        std::size_t scheduledUntil_ = 0;
+        Clock::time_point anchor_;
+        uint64_t anchorNs_ = 0;
+        std::deque<char> ready_;
+        bool readPending_ = false;
+        boost::asio::mutable_buffer readBuffer_;
+        ReadHandler readHandler_;
+        Clock::time_point startedAt_;
+        Clock::time_point lastRxAt_;
+        std::size_t txCount_ = 0;
+        std::size_t rxCount_ = 0;
+        std::size_t mismatches_ = 0;
+        Clock::duration reactionTotal_{ 0 };
+        Clock::duration reactionMax_{ 0 };
+        bool finished_ = false;
+    };
+}
+
+#endif // SERIAL_TRACE_HPP
@@ -0,0 +1,162 @@
+#include "serverStandIn.hpp"
+
+#include <boost/asio/write.hpp>
+#include <boost/log/trivial.hpp>
+
+
+namespace
+{
+  constexpr std::size_t kMaxHandshakeSize = 1024;
+  // Per subscriber, a few seconds of a busy fleet.
+  constexpr std::size_t kMaxOutgoing = 1024 * 1024;
+}
+
+ServerStandIn::Connection::Connection(boost::asio::io_service& ioService) : socket(ioService) {
+}
+
+ServerStandIn::ServerStandIn(boost::asio::io_service& ioService, std::size_t port) : ioService_(ioService),
+acceptor_(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), static_cast<unsigned short>(port))),
+deflate_(TelemetryCodec::Type::DEFLATE_DICT) {
+}
+
+std::size_t ServerStandIn::GetPort() const {
+  return acceptor_.local_endpoint().port();
+}
+
+void ServerStandIn::Start() {
+  BOOST_LOG_TRIVIAL(info) << "Server stand-in listening on 127.0.0.1:" << GetPort();
+  Accept();
+}
+
+const ServerStandIn::Counters& ServerStandIn::GetCounters() const {
+  return counters_;
+}
+
+void ServerStandIn::Accept() {
+  auto connection = std::make_shared<Connection>(ioService_);
+  acceptor_.async_accept(connection->socket, [this, connection](const boost::system::error_code& error) {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (error) {
+      BOOST_LOG_TRIVIAL(warning) << "Stand-in accept failed: " << error.message();
+    }
+    else {
+      ++counters_.connections;
+      boost::system::error_code ec;
+      connection->socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+      Read(connection);
+    }
+    Accept();
+    });
+}
+
+void ServerStandIn::Read(const ConnectionPtr& connection) {
+  connection->socket.async_read_some(boost::asio::buffer(connection->readBuffer),
+    [this, connection](const boost::system::error_code& error, std::size_t size) { OnRead(connection, error, size); });
+}
+
+void ServerStandIn::OnRead(const ConnectionPtr& connection, const boost::system::error_code& error, std::size_t size) {
+  if (error) {
+    Drop(connection);
+    return;
+  }
+  std::string chunk(connection->readBuffer.data(), size);
+  if (!connection->handshaken) {
+    connection->handshake += chunk;
+    auto end = connection->handshake.find('}');
+    if (end == std::string::npos) {
+      if (connection->handshake.size() > kMaxHandshakeSize) {
+        Drop(connection);
+        return;
+      }
+      Read(connection);
+      return;
+    }
+    // Whatever follows the handshake in the same chunk is already data.
+    chunk = connection->handshake.substr(end + 1);
+    connection->handshake.resize(end + 1);
+    OnHandshake(connection);
+  }
+  // Subscribers have nothing to say, reading only notices them leaving.
+  if (!connection->subscriber && !chunk.empty()) {
+    auto relay = [this](const std::vector<char>& frame) { Relay(frame); };
+    auto decoded = connection->codec.Decode(chunk, [&](const std::vector<char>& frame) {
+      if (connection->codec.GetType() == TelemetryCodec::Type::NONE) {
+        connection->objects.Feed(frame, relay);
+        return;
+      }
+      relay(frame);
+      });
+    if (!decoded) {
+      ++counters_.decodeErrors;
+      Drop(connection);
+      return;
+    }
+  }
+  Read(connection);
+}
+
+void ServerStandIn::OnHandshake(const ConnectionPtr& connection) {
+  connection->handshaken = true;
+  const auto& handshake = connection->handshake;
+  connection->subscriber = handshake.find("SUBSCRIBER") != std::string::npos;
+  auto deflateName = TelemetryCodec::TypeToString(TelemetryCodec::Type::DEFLATE_DICT);
+  bool deflate = handshake.find("\"" + deflateName + "\"") != std::string::npos;
+  connection->codec.SetType(deflate ? TelemetryCodec::Type::DEFLATE_DICT : TelemetryCodec::Type::NONE);
+  connection->outgoing = deflate ? "OK " + deflateName : "OK";
+  Write(connection);
+  if (connection->subscriber) {
+    ++counters_.subscribers;
+    subscribers_.insert(connection);
+    return;
+  }
+  ++counters_.publishers;
+}
+
+void ServerStandIn::Relay(const std::vector<char>& frame) {
+  ++counters_.framesIn;
+  bool deflateEncoded = false;
+  for (const auto& subscriber : subscribers_) {
+    const std::vector<char>* out = &frame;
+    if (subscriber->codec.GetType() == TelemetryCodec::Type::DEFLATE_DICT) {
+      // Frames are compressed one by one, once for every deflate subscriber.
+      if (!deflateEncoded && !deflate_.Encode(frame, deflateFrame_)) {
+        ++counters_.decodeErrors;
+        return;
+      }
+      deflateEncoded = true;
+      out = &deflateFrame_;
+    }
+    if (subscriber->outgoing.size() + out->size() > kMaxOutgoing) {
+      ++counters_.droppedFrames;
+      continue;
+    }
+    subscriber->outgoing.append(out->data(), out->size());
+    ++counters_.framesOut;
+    counters_.bytesOut += out->size();
+    Write(subscriber);
+  }
+}
+
+void ServerStandIn::Write(const ConnectionPtr& connection) {
+  if (!connection->writing.empty() || connection->outgoing.empty()) {
+    return;
+  }
+  connection->writing.swap(connection->outgoing);
+  boost::asio::async_write(connection->socket, boost::asio::buffer(connection->writing),
+    [this, connection](const boost::system::error_code& error, std::size_t) {
+      connection->writing.clear();
+      if (error) {
+        Drop(connection);
+        return;
+      }
+      Write(connection);
+    });
+}
+
+void ServerStandIn::Drop(const ConnectionPtr& connection) {
+  subscribers_.erase(connection);
+  boost::system::error_code ec;
+  connection->socket.close(ec);
+}
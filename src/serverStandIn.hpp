@@ -0,0 +1,74 @@
+#ifndef SERVER_STAND_IN_HPP
+#define SERVER_STAND_IN_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "objectStream.hpp"
+#include "telemetryCodec.hpp"
+
+// Local stand-in for the server, enough of it to load the clients: answers the handshake,
+// accepting deflate-v1 when offered, and relays every publisher frame to every subscriber in the
+// subscriber's codec. Frames for a subscriber that can't keep up are dropped once its output
+// queue is full rather than queued without bound.
+class ServerStandIn {
+public:
+    struct Counters {
+        std::size_t connections = 0;
+        std::size_t publishers = 0;
+        std::size_t subscribers = 0;
+        std::size_t framesIn = 0;
+        std::size_t framesOut = 0;
+        std::size_t bytesOut = 0;
+        std::size_t droppedFrames = 0;
+        std::size_t decodeErrors = 0;
+    };
+
+    // Port 0 picks a free one.
+    ServerStandIn(boost::asio::io_service& ioService, std::size_t port);
+
+    std::size_t GetPort() const;
+    void Start();
+    const Counters& GetCounters() const;
+
+private:
+    struct Connection {
+        explicit Connection(boost::asio::io_service& ioService);
+
+        boost::asio::ip::tcp::socket socket;
+        std::array<char, 4096> readBuffer;
+        std::string handshake;
+        bool handshaken = false;
+        bool subscriber = false;
+        TelemetryCodec codec;
+        ObjectStream objects;
+        std::string outgoing;
+        std::string writing;
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    void Accept();
+    void Read(const ConnectionPtr& connection);
+    void OnRead(const ConnectionPtr& connection, const boost::system::error_code& error, std::size_t size);
+    void OnHandshake(const ConnectionPtr& connection);
+    void Relay(const std::vector<char>& frame);
+    void Write(const ConnectionPtr& connection);
+    void Drop(const ConnectionPtr& connection);
+
+private:
+    boost::asio::io_service& ioService_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::set<ConnectionPtr> subscribers_;
+    TelemetryCodec deflate_;
+    std::vector<char> deflateFrame_;
+    Counters counters_;
+};
+
+#endif // SERVER_STAND_IN_HPP
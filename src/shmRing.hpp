@@ -0,0 +1,67 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared memory ring the subscriber publishes downlink frames into.
+// One writer, any number of readers, each reader keeps its own cursor.
+//
+// Slot for sequence number n is n % slotCount. The writer zeroes the slot sequence,
+// copies the frame and then stores n, readers validate the sequence before and after
+// copying, so an overwritten slot is detected instead of returning torn data.
+namespace ShmRing
+{
+    constexpr uint32_t kMagic = 0x52504952; // "RPIR"
+    constexpr uint32_t kVersion = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+        alignas(64) std::atomic<uint64_t> writeSeq;
+    };
+
+    struct SlotHeader {
+        std::atomic<uint64_t> seq;
+        uint32_t length;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring needs lock free 64 bit atomics");
+
+    inline std::size_t AlignToCacheLine(std::size_t size) {
+        return (size + 63) & ~std::size_t(63);
+    }
+
+    inline std::size_t SlotStride(uint32_t slotSize) {
+        return AlignToCacheLine(sizeof(SlotHeader) + slotSize);
+    }
+
+    inline std::size_t MappingSize(uint32_t slotCount, uint32_t slotSize) {
+        return AlignToCacheLine(sizeof(Header)) + SlotStride(slotSize) * slotCount;
+    }
+
+    inline SlotHeader* Slot(void* mapping, uint64_t seq) {
+        auto header = static_cast<Header*>(mapping);
+        auto slots = static_cast<char*>(mapping) + AlignToCacheLine(sizeof(Header));
+        return reinterpret_cast<SlotHeader*>(slots + SlotStride(header->slotSize) * (seq % header->slotCount));
+    }
+
+    inline char* SlotData(SlotHeader* slot) {
+        return reinterpret_cast<char*>(slot) + sizeof(SlotHeader);
+    }
+
+    // Readers register by sending their socket address to this path, the writer then
+    // sends them the 8 byte sequence number of every published frame.
+    inline std::string NotificationSocketPath(const std::string& name) {
+        return "/tmp/" + name + ".sock";
+    }
+
+    inline std::string SharedMemoryName(const std::string& name) {
+        return "/" + name;
+    }
+}
+
+#endif // SHM_RING_HPP
@@ -0,0 +1,165 @@
+#include "shmRingReader.hpp"
+
+#include "shmRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+ShmRingReader::~ShmRingReader() {
+  if (mapping_) {
+    munmap(mapping_, mappingSize_);
+  }
+  if (!socketPath_.empty()) {
+    unlink(socketPath_.c_str());
+  }
+}
+
+bool ShmRingReader::Open(const std::string& name, bool fromOldest) {
+  name_ = name;
+  return Map(fromOldest) && Subscribe(name);
+}
+
+// Maps the ring currently published under name_, the previous mapping is only replaced
+// once the new one is valid.
+bool ShmRingReader::Map(bool fromOldest) {
+  ScopedFd shmFd(shm_open(ShmRing::SharedMemoryName(name_).c_str(), O_RDONLY, 0));
+  if (shmFd.get() < 0) {
+    return false;
+  }
+  struct stat info {};
+  if (fstat(shmFd.get(), &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(ShmRing::Header)) {
+    return false;
+  }
+  std::size_t mappingSize = info.st_size;
+  auto mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, shmFd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  auto header = static_cast<const ShmRing::Header*>(mapping);
+  if (header->magic != ShmRing::kMagic || header->version != ShmRing::kVersion ||
+    mappingSize < ShmRing::MappingSize(header->slotCount, header->slotSize)) {
+    munmap(mapping, mappingSize);
+    return false;
+  }
+  if (mapping_) {
+    munmap(mapping_, mappingSize_);
+  }
+  shmFd_ = std::move(shmFd);
+  mapping_ = mapping;
+  mappingSize_ = mappingSize;
+  inode_ = info.st_ino;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto writeSeq = header->writeSeq.load(std::memory_order_acquire);
+  cursor_ = writeSeq + 1;
+  if (fromOldest) {
+    cursor_ = writeSeq >= header->slotCount ? writeSeq - header->slotCount + 1 : 1;
+  }
+  return true;
+}
+
+bool ShmRingReader::Subscribe(const std::string& name) {
+  socketFd_.reset(socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0));
+  if (socketFd_.get() < 0) {
+    return false;
+  }
+  socketPath_ = "/tmp/" + name + "." + std::to_string(getpid()) + "." + std::to_string(reinterpret_cast<uintptr_t>(this)) + ".sock";
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath_.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::strcpy(address.sun_path, socketPath_.c_str());
+  unlink(socketPath_.c_str());
+  if (bind(socketFd_.get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    return false;
+  }
+  auto writerPath = ShmRing::NotificationSocketPath(name);
+  sockaddr_un writer{};
+  writer.sun_family = AF_UNIX;
+  std::strncpy(writer.sun_path, writerPath.c_str(), sizeof(writer.sun_path) - 1);
+  const char subscribe[] = "SUBSCRIBE";
+  return sendto(socketFd_.get(), subscribe, sizeof(subscribe) - 1, 0, reinterpret_cast<sockaddr*>(&writer), sizeof(writer)) >= 0;
+}
+
+ShmRingReader::Result ShmRingReader::Read(std::vector<char>& frame) {
+  if (restarted_) {
+    restarted_ = false;
+    return Result::RESTARTED;
+  }
+  auto header = static_cast<ShmRing::Header*>(mapping_);
+  auto writeSeq = header->writeSeq.load(std::memory_order_acquire);
+  if (cursor_ > writeSeq) {
+    return Result::EMPTY;
+  }
+  if (writeSeq - cursor_ >= header->slotCount) {
+    auto oldest = writeSeq - header->slotCount + 1;
+    lostFrames_ += oldest - cursor_;
+    cursor_ = oldest;
+    return Result::OVERRUN;
+  }
+  auto slot = ShmRing::Slot(mapping_, cursor_);
+  if (slot->seq.load(std::memory_order_acquire) != cursor_) {
+    return SkipOverwritten();
+  }
+  auto length = std::min<uint32_t>(slot->length, header->slotSize);
+  frame.resize(length);
+  std::memcpy(frame.data(), ShmRing::SlotData(slot), length);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->seq.load(std::memory_order_relaxed) != cursor_) {
+    return SkipOverwritten();
+  }
+  ++cursor_;
+  return Result::OK;
+}
+
+// The writer overwrote the slot under the cursor, so it lapped the reader since writeSeq was
+// read. Skips to the oldest frame still intact, the one after writeSeq may be half written.
+ShmRingReader::Result ShmRingReader::SkipOverwritten() {
+  auto header = static_cast<ShmRing::Header*>(mapping_);
+  auto writeSeq = header->writeSeq.load(std::memory_order_acquire);
+  auto oldest = writeSeq + 2 > header->slotCount ? writeSeq + 2 - header->slotCount : 1;
+  oldest = std::max(oldest, cursor_ + 1);
+  lostFrames_ += oldest - cursor_;
+  cursor_ = oldest;
+  return Result::OVERRUN;
+}
+
+bool ShmRingReader::WaitForData(std::chrono::milliseconds timeout) {
+  auto header = static_cast<ShmRing::Header*>(mapping_);
+  if (cursor_ <= header->writeSeq.load(std::memory_order_acquire)) {
+    return true;
+  }
+  pollfd descriptor{ socketFd_.get(), POLLIN, 0 };
+  if (poll(&descriptor, 1, timeout.count()) <= 0) {
+    // A restarted writer neither knows this reader's socket nor writes into the old segment.
+    if (WriterRestarted() && Map(true) && Subscribe(name_)) {
+      restarted_ = true;
+      return true;
+    }
+    return cursor_ <= header->writeSeq.load(std::memory_order_acquire);
+  }
+  // Drain every pending wakeup, the ring itself is the source of truth.
+  uint64_t seq = 0;
+  while (recv(socketFd_.get(), &seq, sizeof(seq), MSG_DONTWAIT) > 0) {
+  }
+  return cursor_ <= header->writeSeq.load(std::memory_order_acquire);
+}
+
+// The writer unlinks the old segment when it opens, a different inode under the name is a new ring.
+bool ShmRingReader::WriterRestarted() const {
+  ScopedFd shmFd(shm_open(ShmRing::SharedMemoryName(name_).c_str(), O_RDONLY, 0));
+  struct stat info {};
+  return shmFd.get() >= 0 && fstat(shmFd.get(), &info) == 0 && info.st_ino != inode_;
+}
+
+uint64_t ShmRingReader::GetLostFrames() const {
+  return lostFrames_;
+}
@@ -0,0 +1,66 @@
+#ifndef SHM_RING_READER_HPP
+#define SHM_RING_READER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "scopedFd.hpp"
+
+// Reader side of the subscriber's downlink ring (see shmRing.hpp).
+// Link against the shmRingReader library, no boost needed:
+//
+//   ShmRingReader reader;
+//   reader.Open("rpiclient-downlink");
+//   std::vector<char> frame;
+//   while (reader.WaitForData(1s)) {
+//       while (reader.Read(frame) != ShmRingReader::Result::EMPTY) { ... }
+//   }
+class ShmRingReader {
+public:
+    enum class Result {
+        OK,
+        EMPTY,
+        // The writer lapped this reader, GetLostFrames() tells how many frames were skipped.
+        OVERRUN,
+        // The writer was restarted, reading goes on from the oldest frame of its new ring.
+        // Frames published by the old writer after this reader's cursor aren't counted as lost.
+        RESTARTED,
+    };
+
+    ShmRingReader() = default;
+    ~ShmRingReader();
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    // Starts at the newest frame unless fromOldest is set.
+    bool Open(const std::string& name, bool fromOldest = false);
+    Result Read(std::vector<char>& frame);
+    // Blocks until the writer announces a new frame or timeout expires. When nothing arrives
+    // it checks whether the writer was restarted on a new segment and remaps it.
+    bool WaitForData(std::chrono::milliseconds timeout);
+    uint64_t GetLostFrames() const;
+
+private:
+    bool Map(bool fromOldest);
+    bool Subscribe(const std::string& name);
+    bool WriterRestarted() const;
+    Result SkipOverwritten();
+
+private:
+    std::string name_;
+    ScopedFd shmFd_;
+    ScopedFd socketFd_;
+    std::string socketPath_;
+    void* mapping_ = nullptr;
+    std::size_t mappingSize_ = 0;
+    ino_t inode_ = 0;
+    bool restarted_ = false;
+    uint64_t cursor_ = 1;
+    uint64_t lostFrames_ = 0;
+};
+
+#endif // SHM_RING_READER_HPP
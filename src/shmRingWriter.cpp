@@ -0,0 +1,133 @@
+#include "shmRingWriter.hpp"
+
+#include "shmRing.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+ShmRingWriter::ShmRingWriter(boost::asio::io_service& ioService) : socket_(ioService) {}
+
+ShmRingWriter::~ShmRingWriter() {
+  if (mapping_) {
+    munmap(mapping_, mappingSize_);
+    shm_unlink(ShmRing::SharedMemoryName(name_).c_str());
+  }
+  if (socket_.is_open()) {
+    socket_.close();
+    unlink(ShmRing::NotificationSocketPath(name_).c_str());
+  }
+}
+
+bool ShmRingWriter::Open(const std::string& name, uint32_t slotCount, uint32_t slotSize) {
+  name_ = name;
+  auto shmName = ShmRing::SharedMemoryName(name);
+  shm_unlink(shmName.c_str());
+  shmFd_.reset(shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644));
+  if (shmFd_.get() < 0) {
+    BOOST_LOG_TRIVIAL(error) << "shm_open(" << shmName << ") failed: " << std::strerror(errno);
+    return false;
+  }
+  mappingSize_ = ShmRing::MappingSize(slotCount, slotSize);
+  if (ftruncate(shmFd_.get(), mappingSize_) != 0) {
+    BOOST_LOG_TRIVIAL(error) << "ftruncate of shared memory failed: " << std::strerror(errno);
+    return false;
+  }
+  auto mapping = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd_.get(), 0);
+  if (mapping == MAP_FAILED) {
+    BOOST_LOG_TRIVIAL(error) << "mmap of shared memory failed: " << std::strerror(errno);
+    return false;
+  }
+  mapping_ = mapping;
+  auto header = new (mapping_) ShmRing::Header();
+  header->slotCount = slotCount;
+  header->slotSize = slotSize;
+  header->version = ShmRing::kVersion;
+  header->writeSeq.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < slotCount; ++i) {
+    new (ShmRing::Slot(mapping_, i)) ShmRing::SlotHeader();
+  }
+  // Readers check the magic last, so they never see a half initialized ring.
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = ShmRing::kMagic;
+
+  auto socketPath = ShmRing::NotificationSocketPath(name);
+  unlink(socketPath.c_str());
+  boost::system::error_code ec;
+  socket_.open(boost::asio::local::datagram_protocol(), ec);
+  if (!ec) {
+    socket_.bind(Endpoint(socketPath), ec);
+  }
+  if (ec) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to bind notification socket " << socketPath << ": " << ec.message();
+    return false;
+  }
+  socket_.non_blocking(true);
+  ReceiveSubscription();
+  BOOST_LOG_TRIVIAL(info) << "Shared memory ring " << shmName << " ready, " << slotCount << " slots of " << slotSize << " bytes";
+  return true;
+}
+
+bool ShmRingWriter::IsOpen() const {
+  return mapping_ != nullptr;
+}
+
+bool ShmRingWriter::Publish(const char* data, std::size_t size) {
+  if (!mapping_) {
+    return false;
+  }
+  auto header = static_cast<ShmRing::Header*>(mapping_);
+  if (size > header->slotSize) {
+    BOOST_LOG_TRIVIAL(error) << "Frame of " << size << " bytes doesn't fit ring slot of " << header->slotSize;
+    return false;
+  }
+  auto seq = header->writeSeq.load(std::memory_order_relaxed) + 1;
+  auto slot = ShmRing::Slot(mapping_, seq);
+  slot->seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->length = size;
+  std::memcpy(ShmRing::SlotData(slot), data, size);
+  slot->seq.store(seq, std::memory_order_release);
+  header->writeSeq.store(seq, std::memory_order_release);
+  Notify(seq);
+  return true;
+}
+
+void ShmRingWriter::ReceiveSubscription() {
+  socket_.async_receive_from(boost::asio::buffer(subscription_), sender_,
+    std::bind(&ShmRingWriter::OnSubscription, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void ShmRingWriter::OnSubscription(const boost::system::error_code& error, std::size_t) {
+  if (error) {
+    if (error != boost::asio::error::operation_aborted) {
+      BOOST_LOG_TRIVIAL(error) << "Notification socket error: " << error.message();
+    }
+    return;
+  }
+  if (std::find(readers_.begin(), readers_.end(), sender_) == readers_.end()) {
+    BOOST_LOG_TRIVIAL(info) << "Ring reader registered: " << sender_.path();
+    readers_.push_back(sender_);
+  }
+  ReceiveSubscription();
+}
+
+void ShmRingWriter::Notify(uint64_t seq) {
+  // A busy or gone reader must never stall the modem thread, it just misses the wakeup.
+  auto it = readers_.begin();
+  while (it != readers_.end()) {
+    boost::system::error_code ec;
+    socket_.send_to(boost::asio::buffer(&seq, sizeof(seq)), *it, 0, ec);
+    if (ec && ec != boost::asio::error::would_block && ec != boost::asio::error::no_buffer_space) {
+      BOOST_LOG_TRIVIAL(info) << "Ring reader gone: " << it->path();
+      it = readers_.erase(it);
+      continue;
+    }
+    ++it;
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef SHM_RING_WRITER_HPP
+#define SHM_RING_WRITER_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/datagram_protocol.hpp>
+
+#include "scopedFd.hpp"
+
+// Publishes frames into the shared memory ring described in shmRing.hpp and
+// notifies registered local readers over a unix datagram socket.
+class ShmRingWriter {
+public:
+    ShmRingWriter(boost::asio::io_service& ioService);
+    ~ShmRingWriter();
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    bool Open(const std::string& name, uint32_t slotCount, uint32_t slotSize);
+    bool Publish(const char* data, std::size_t size);
+    bool IsOpen() const;
+
+private:
+    void ReceiveSubscription();
+    void OnSubscription(const boost::system::error_code& error, std::size_t size);
+    void Notify(uint64_t seq);
+
+private:
+    using Endpoint = boost::asio::local::datagram_protocol::endpoint;
+
+    std::string name_;
+    ScopedFd shmFd_;
+    void* mapping_ = nullptr;
+    std::size_t mappingSize_ = 0;
+    boost::asio::local::datagram_protocol::socket socket_;
+    Endpoint sender_;
+    std::array<char, 16> subscription_;
+    std::vector<Endpoint> readers_;
+};
+
+#endif // SHM_RING_WRITER_HPP
@@ -8,27 +8,39 @@
 
 namespace
 {
-  constexpr const char kErrorReply[] = "ERROR";
-  std::string RemoveWhitespaces(std::string txt) {
+  constexpr const char kUnsolicitedDataPrefix[] = "+IPD,";
+  // Replies and unsolicited data are buffered in storage of this size reserved up front.
+  constexpr std::size_t kMaxResponseSize = 4096;
+  constexpr std::size_t kMaxLoggedCommandSize = 64;
+
+  std::string_view View(const std::vector<char>& buffer) {
+    return { buffer.data(), buffer.size() };
+  }
+
+  void StripNewLines(std::string& txt) {
     txt.erase(std::remove(txt.begin(), std::remove(txt.begin(), txt.end(), '\n'), '\r'), txt.end());
+  }
+
+  std::string RemoveWhitespaces(std::string txt) {
+    StripNewLines(txt);
     return txt;
   }
 }
 
 Sim800::Sim800(ExtendedSerialPort& serialPort) : serialPort_(serialPort),
 ioService_(serialPort_.get_io_service()),
-timeout_(ioService_) {}
+timeout_(ioService_) {
+  result_.reserve(kMaxResponseSize);
+  specialResult_.reserve(kMaxResponseSize);
+  command_.reserve(kMaxLoggedCommandSize);
+  lateEcho_.reserve(AtCommands::kMaxCommandSize);
+}
 
-void Sim800::Execute(const std::string& atCommand, std::vector<std::string> expectedResult, StringResultCallback cb, std::chrono::milliseconds timeout, bool clearNewLines)
+void Sim800::WriteForStatus(std::string_view data, const AtCommands::Reply& reply, BoolResultCallback cb)
 {
-  PreExecute(atCommand, std::move(cb), timeout, clearNewLines);
-  expectedResult_ = std::move(expectedResult);
-  serialPort_.async_read_some(boost::asio::buffer(tmpBuffer_),
-    boost::bind(&Sim800::ReadSomeUntilPredicateOrTimeout, this,
-      [this](const std::vector<char>& buffer) {
-        return ContainsExpectedResult();
-      }, boost::asio::placeholders::error,
-      boost::asio::placeholders::bytes_transferred));
+  cb_ = nullptr;
+  statusCb_ = std::move(cb);
+  Write(data, reply, false);
 }
 
 void Sim800::ReadAmountOfData(std::size_t amountOfCharactersToRead, StringResultCallback cb) {
@@ -55,69 +67,155 @@ void Sim800::ReadAmountOfData(std::size_t amountOfCharactersToRead, StringResult
 
 }
 
-void Sim800::ReadSomeUntilContainsOrWord(const std::vector<std::string>& expectedResult, const std::string& word, StringResultCallback cb) {
-  auto readCb = [this, expectedResult, cb](OptionalString result) {
+void Sim800::ReadSomeUntilContainsOrWord(const AtCommands::TokenSequence& expectedResult, const AtCommands::TokenSequence& word,
+  StringResultCallback cb) {
+  auto readCb = [this, &expectedResult, cb](OptionalString result) {
     if (!result) {
       PostCallbackWithResult(std::move(cb), std::experimental::nullopt);
       return;
     }
-    auto expectedResultInfo = Contains(specialResult_, expectedResult);
-    if (expectedResultInfo.first) {
-      PostCallbackWithResult(cb, std::string(specialResult_.begin(), expectedResultInfo.second));
-      specialResult_.erase(specialResult_.begin(), expectedResultInfo.second);
+    auto end = expectedResult.Match(View(specialResult_));
+    if (end != AtCommands::TokenSequence::npos) {
+      PostCallbackWithResult(cb, std::string(specialResult_.begin(), specialResult_.begin() + end));
+      specialResult_.erase(specialResult_.begin(), specialResult_.begin() + end);
       return;
     }
     PostCallbackWithResult(cb, std::experimental::nullopt);
   };
+  auto predicate = [this, &expectedResult, &word](const std::vector<char>& buffer) {
+    return expectedResult.Match(View(specialResult_)) != AtCommands::TokenSequence::npos ||
+      word.Match(View(specialResult_)) != AtCommands::TokenSequence::npos;
+  };
+  // Data kept behind a command response is already complete, don't wait for the modem to send more.
+  if (predicate(specialResult_)) {
+    readCb(std::string(specialResult_.begin(), specialResult_.end()));
+    return;
+  }
   serialPort_.async_read_some(boost::asio::buffer(tmpBuffer_),
-    boost::bind(&Sim800::ReadSomeUntilPredicate, this, [this, expectedResult, word](const std::vector<char>& buffer) {
-      return Contains(specialResult_, expectedResult).first || Contains(specialResult_, { word }).first;
-      }, readCb, boost::asio::placeholders::error,
+    boost::bind(&Sim800::ReadSomeUntilPredicate, this, predicate, readCb, boost::asio::placeholders::error,
       boost::asio::placeholders::bytes_transferred));
 }
 
-void Sim800::PreExecute(const std::string& atCommand, StringResultCallback cb, std::chrono::milliseconds timeout, bool clearNewLines) {
-  auto commandToLog = RemoveWhitespaces(atCommand);
-  BOOST_LOG_TRIVIAL(info) << "Executing command: [ " << commandToLog << " ]";
+void Sim800::PreExecute(std::size_t commandSize, const AtCommands::Reply& reply) {
+  if (commandSize == 0) {
+    BOOST_LOG_TRIVIAL(error) << "AT command longer than " << AtCommands::kMaxCommandSize << " bytes";
+    CompleteCommand(false);
+    return;
+  }
+  Write({ commandBuffer_.data(), commandSize }, reply, true);
+}
+
+void Sim800::Write(std::string_view data, const AtCommands::Reply& reply, bool echoed) {
+  command_.assign(data.data(), std::min(data.size(), kMaxLoggedCommandSize));
+  StripNewLines(command_);
+  BOOST_LOG_TRIVIAL(info) << "Executing command: [ " << RemoveWhitespaces(std::string(data)) << " ]";
   result_.clear();
-  clearNewLines_ = clearNewLines;
-  cb_ = std::move(cb);
-  serialPort_.write_some(boost::asio::buffer(atCommand));
-  timeout_.expires_from_now(timeout);
-  timeout_.async_wait(boost::bind(&Sim800::OnTimeout, this, commandToLog, boost::asio::placeholders::error));
+  pending_ = data;
+  // The command name is enough to tell replies apart, a replay may differ in the arguments.
+  auto echoEnd = echoed ? data.find_first_of("=?\r") : std::string_view::npos;
+  echo_ = echoEnd == std::string_view::npos ? std::string_view() : data.substr(0, echoEnd + 1);
+  reply_ = &reply;
+  retried_ = false;
+  serialPort_.write_some(boost::asio::buffer(data.data(), data.size()));
+  StartTimeout();
   timeouted_ = false;
+  serialPort_.async_read_some(boost::asio::buffer(tmpBuffer_), MakePooledHandler(readMemory_,
+    boost::bind(&Sim800::ReadSomeUntilPredicateOrTimeout, this,
+      [this](const std::vector<char>& buffer) {
+        return ContainsExpectedResult();
+      }, boost::asio::placeholders::error,
+      boost::asio::placeholders::bytes_transferred)));
+}
+
+
+void Sim800::StartTimeout() {
+  timeout_.expires_from_now(reply_->timeout);
+  timeout_.async_wait(MakePooledHandler(timeoutMemory_,
+    boost::bind(&Sim800::OnTimeout, this, boost::asio::placeholders::error)));
+}
+
+void Sim800::CancelRead() {
+  serialPort_.cancel();
 }
 
+bool Sim800::HasPendingData() {
+  return AtCommands::kIncomingDataHeader.Match(View(specialResult_)) != AtCommands::TokenSequence::npos;
+}
+
+std::size_t Sim800::ReplyStart() {
+  if (echo_.empty()) {
+    return 0;
+  }
+  auto view = View(result_);
+  auto echo = view.find(echo_);
+  if (echo != std::string_view::npos && lateEcho_ == echo_) {
+    echo = view.find(echo_, echo + echo_.size());
+  }
+  if (echo == std::string_view::npos) {
+    return echoSeen_ ? std::string_view::npos : 0;
+  }
+  echoSeen_ = true;
+  return echo + echo_.size();
+}
+
+std::size_t Sim800::ExpectedEnd() {
+  auto start = ReplyStart();
+  if (start == std::string_view::npos) {
+    return AtCommands::TokenSequence::npos;
+  }
+  auto end = reply_->expected.Match(View(result_).substr(start));
+  return end == AtCommands::TokenSequence::npos ? end : start + end;
+}
 
 bool Sim800::ContainsError()
 {
-  return Contains(result_, { {kErrorReply} }).first;
+  auto start = ReplyStart();
+  return start != std::string_view::npos && reply_->errors.MatchAny(View(result_).substr(start));
 }
 
 bool Sim800::ContainsExpectedResult()
 {
-  return Contains(result_, expectedResult_).first;
+  return ExpectedEnd() != AtCommands::TokenSequence::npos;
 }
 
-std::pair<bool, std::vector<char>::iterator> Sim800::Contains(std::vector<char>& buffer, const std::vector<std::string>& searchWords)
+void Sim800::KeepUnsolicitedData()
 {
-  auto it = buffer.begin();
-  for (const auto& word : searchWords)
-  {
-    it = std::search(it, buffer.end(), word.begin(), word.end());
-    if (it == buffer.end())
-    {
-      return std::make_pair(false, it);
+  // Incoming data may arrive right before or behind the command response, hand it over to the data reader.
+  constexpr std::size_t kPrefixSize = sizeof(kUnsolicitedDataPrefix) - 1;
+  auto expectedEnd = ExpectedEnd();
+  auto block = std::search(result_.begin(), result_.begin() + expectedEnd, kUnsolicitedDataPrefix, kUnsolicitedDataPrefix + kPrefixSize);
+  while (block != result_.begin() + expectedEnd) {
+    std::size_t size = 0;
+    auto it = block + kPrefixSize;
+    for (; it != result_.end() && *it >= '0' && *it <= '9'; ++it) {
+      size = size * 10 + (*it - '0');
+    }
+    if (it == result_.end() || *it != ':' || static_cast<std::size_t>(result_.end() - it - 1) < size) {
+      break;
+    }
+    auto blockEnd = it + 1 + size;
+    specialResult_.insert(specialResult_.end(), block, blockEnd);
+    block = result_.erase(block, blockEnd);
+    expectedEnd = ExpectedEnd();
+    if (expectedEnd == AtCommands::TokenSequence::npos) {
+      // The reply was inside the data.
+      return;
     }
-    it += word.size();
+    block = std::search(block, result_.begin() + expectedEnd, kUnsolicitedDataPrefix, kUnsolicitedDataPrefix + kPrefixSize);
   }
-  return std::make_pair(true, it);
+  auto unsolicited = std::search(result_.begin() + expectedEnd, result_.end(),
+    kUnsolicitedDataPrefix, kUnsolicitedDataPrefix + kPrefixSize);
+  specialResult_.insert(specialResult_.end(), unsolicited, result_.end());
+  result_.erase(unsolicited, result_.end());
 }
 
 void Sim800::ReadSomeUntilPredicate(std::function<bool(const std::vector<char>& buffer)> predicate,
   StringResultCallback resultCb,
   const boost::system::error_code& error, std::size_t readBytes) {
 
+  if (error == boost::asio::error::operation_aborted) {
+    return;
+  }
   if (error) {
     BOOST_LOG_TRIVIAL(error) << "This error ocurred during reading the data " << error.message();
     PostCallbackWithResult(resultCb, std::experimental::nullopt);
@@ -135,43 +233,72 @@ void Sim800::ReadSomeUntilPredicate(std::function<bool(const std::vector<char>&
 
 void Sim800::ReadSomeUntilPredicateOrTimeout(std::function<bool(const std::vector<char>& buffer)> predicate, const boost::system::error_code& error, std::size_t readBytes)
 {
-  if (timeouted_ == true) {
+  if (timeouted_ == true || error == boost::asio::error::operation_aborted) {
     return;
   }
   if (error) {
     BOOST_LOG_TRIVIAL(error) << "This error ocurred during reading the data " << error.message();
-    PostCallbackWithResult(cb_, std::experimental::nullopt);
+    CompleteCommand(false);
     return;
   }
   result_.insert(result_.end(), tmpBuffer_.begin(), tmpBuffer_.begin() + readBytes);
   if (!ContainsError() && !predicate(result_)) {
-    serialPort_.async_read_some(boost::asio::buffer(tmpBuffer_),
+    serialPort_.async_read_some(boost::asio::buffer(tmpBuffer_), MakePooledHandler(readMemory_,
       boost::bind(&Sim800::ReadSomeUntilPredicateOrTimeout, this, predicate, boost::asio::placeholders::error,
-        boost::asio::placeholders::bytes_transferred));
+        boost::asio::placeholders::bytes_transferred)));
     return;
   }
-  auto withoutWhitespaces = RemoveWhitespaces(std::string(result_.begin(), result_.end()));
-  BOOST_LOG_TRIVIAL(info) << "Result [ " << withoutWhitespaces << " ]";
+  if (!ContainsError()) {
+    KeepUnsolicitedData();
+  }
+  BOOST_LOG_TRIVIAL(info) << "Result [ " << RemoveWhitespaces(std::string(result_.begin(), result_.end())) << " ]";
   if (ContainsError()) {
     BOOST_LOG_TRIVIAL(error) << "Response contains ERROR message";
     BOOST_LOG_TRIVIAL(error) << "Response ";
-    PostCallbackWithResult(cb_, std::experimental::nullopt);
+    CompleteCommand(false);
+    return;
+  }
+  CompleteCommand(true);
+}
+
+void Sim800::CompleteCommand(bool success) {
+  timeout_.cancel();
+  auto start = success ? ReplyStart() : 0;
+  auto lateReply = success && retried_ && !echo_.empty() &&
+    View(result_).find(echo_, start) == std::string_view::npos;
+  if (lateReply) {
+    lateEcho_.assign(echo_.data(), echo_.size());
+  }
+  else {
+    lateEcho_.clear();
+  }
+  if (statusCb_) {
+    PostCallbackWithArgs(statusCb_, bool(success));
     return;
   }
-  if (clearNewLines_) {
-    // auto endWithoutNewLines = std::remove(result_.begin(), result_.end(), '\n');
-    // auto endWithoutCarriageReturn = std::remove(result_.begin(), endWithoutNewLines, '\r');
-    PostCallbackWithResult(cb_, withoutWhitespaces);
+  if (!success) {
+    PostCallbackWithArgs(cb_, OptionalString());
     return;
   }
-  PostCallbackWithResult(cb_, std::string(result_.begin(), result_.end()));
+  std::string result(result_.begin() + start, result_.end());
+  StripNewLines(result);
+  PostCallbackWithArgs(cb_, OptionalString(std::move(result)));
 }
 
-void Sim800::OnTimeout(std::string command, const boost::system::error_code& error) {
+void Sim800::OnTimeout(const boost::system::error_code& error) {
+  // An idempotent command gets one more chance, the read in flight keeps collecting the reply.
+  // Whichever of the two replies comes first completes it, matched behind the first echo.
+  if (!error && reply_->retryable && !retried_) {
+    retried_ = true;
+    BOOST_LOG_TRIVIAL(warning) << "Request [ " << command_ << " ] timeouted, retrying";
+    serialPort_.write_some(boost::asio::buffer(pending_.data(), pending_.size()));
+    StartTimeout();
+    return;
+  }
   if (!error) {
     timeouted_ = true;
-    BOOST_LOG_TRIVIAL(error) << "Request [ " << command << " ]timeouted";
-    PostCallbackWithResult(cb_, std::experimental::nullopt);
+    BOOST_LOG_TRIVIAL(error) << "Request [ " << command_ << " ]timeouted";
+    CompleteCommand(false);
   }
 }
 
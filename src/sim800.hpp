@@ -1,20 +1,18 @@
 #ifndef SIM_800_HPP
 #define SIM_800_HPP
 
+#include <array>
 #include <chrono>
 #include <experimental/optional>
+#include <string_view>
 #include <utility>
 
 #include <boost/asio.hpp>
 #include <boost/asio/high_resolution_timer.hpp>
 
+#include "atCommands.hpp"
 #include "extendedSerialPort.hpp"
-
-namespace
-{
-    using namespace std::chrono_literals;
-    std::chrono::milliseconds kDefaultTimeout = 2s;
-}
+#include "handlerMemory.hpp"
 
 class Sim800
 {
@@ -22,15 +20,38 @@ public:
     using Timeout = boost::asio::high_resolution_timer;
     using OptionalString = std::experimental::optional<std::string>;
     using StringResultCallback = std::function<void(OptionalString)>;
+    using BoolResultCallback = std::function<void(bool)>;
 
     Sim800(ExtendedSerialPort& serialPort);
     virtual ~Sim800() = default;
 
 protected:
-    void Execute(const std::string& atCommand, std::vector<std::string> expectedResult, StringResultCallback cb,
-        std::chrono::milliseconds timeout = kDefaultTimeout, bool clearNewLines = true);
+    // Commands come from the AtCommands catalog, the arguments are formatted into preallocated
+    // storage and the reply is matched against the catalog's static tables.
+    template<typename... Args>
+    void Execute(const AtCommands::Command<Args...>& command, StringResultCallback cb, AtCommands::ArgumentType<Args>... args) {
+        cb_ = std::move(cb);
+        statusCb_ = nullptr;
+        PreExecute(command.Format(commandBuffer_, args...), command.GetReply());
+    }
+    // For commands whose reply only tells success or failure, the reply is never copied out.
+    template<typename... Args>
+    void ExecuteForStatus(const AtCommands::Command<Args...>& command, BoolResultCallback cb, AtCommands::ArgumentType<Args>... args) {
+        cb_ = nullptr;
+        statusCb_ = std::move(cb);
+        PreExecute(command.Format(commandBuffer_, args...), command.GetReply());
+    }
+    // Raw bytes, like a CIPSEND payload, which must stay valid until cb is called.
+    void WriteForStatus(std::string_view data, const AtCommands::Reply& reply, BoolResultCallback cb);
     void ReadAmountOfData(std::size_t amountOfCharactersToRead, StringResultCallback cb);
-    void ReadSomeUntilContainsOrWord(const std::vector<std::string>& expectedResult, const std::string& word, StringResultCallback cb);
+    // Both token sequences are catalog entries, they are referenced until cb is called.
+    void ReadSomeUntilContainsOrWord(const AtCommands::TokenSequence& expectedResult, const AtCommands::TokenSequence& word,
+        StringResultCallback cb);
+    // A whole +IPD header is buffered, only its payload may still be on the way. Bytes still in
+    // the UART may be anything, a URC as well, they are picked up by the next command.
+    bool HasPendingData();
+    // Drops the read in flight, data or a command reply, its callback isn't called.
+    void CancelRead();
 
     template<typename... U>
     void PostCallbackWithArgs(std::function<void(U...)> cb, U&&... args) {
@@ -38,30 +59,57 @@ protected:
     };
 
 private:
-    void PreExecute(const std::string& atCommand, StringResultCallback cb, std::chrono::milliseconds timeout, bool clearNewLines);
+    // commandSize is what Format wrote to commandBuffer_, 0 when the command didn't fit.
+    void PreExecute(std::size_t commandSize, const AtCommands::Reply& reply);
+    // echoed for AT commands, the modem echoes them back in front of the reply.
+    void Write(std::string_view data, const AtCommands::Reply& reply, bool echoed);
+    void StartTimeout();
+    void CompleteCommand(bool success);
+    // Offset in result_ where the running command's reply starts, npos while its echo is missing.
+    std::size_t ReplyStart();
+    // Offset in result_ behind the expected reply, npos until it is complete.
+    std::size_t ExpectedEnd();
     bool ContainsError();
     bool ContainsExpectedResult();
-    std::pair<bool, std::vector<char>::iterator> Contains(std::vector<char>& buffer, const std::vector<std::string>& searchWords);
+    void KeepUnsolicitedData();
     void ReadSomeUntilPredicate(std::function<bool(const std::vector<char>& buffer)> predicate,
         StringResultCallback resultCb,
         const boost::system::error_code& error, std::size_t readBytes);
     void ReadSomeUntilPredicateOrTimeout(std::function<bool(const std::vector<char>& buffer)> predicate,
         const boost::system::error_code& error, std::size_t readBytes);
-    void OnTimeout(std::string command, const boost::system::error_code& error);
+    void OnTimeout(const boost::system::error_code& error);
     void PostCallbackWithResult(StringResultCallback cb, std::experimental::optional<std::string> result);
 
 
 private:
     ExtendedSerialPort& serialPort_;
     boost::asio::io_service& ioService_;
-    std::vector<std::string> expectedResult_;
+    std::array<char, AtCommands::kMaxCommandSize> commandBuffer_;
+    // What was written for the running command and the reply it waits for.
+    std::string_view pending_;
+    const AtCommands::Reply* reply_ = nullptr;
+    bool retried_ = false;
+    // A late reply to an earlier command must not complete the running one, so once the modem
+    // has been seen echoing, replies are only matched behind the running command's echo. Empty
+    // for raw payloads, which aren't echoed.
+    std::string_view echo_;
+    bool echoSeen_ = false;
+    // Echo of a retried command that completed on its first reply, the second one is still on
+    // the way. The next command skips it if it is the same.
+    std::string lateEcho_;
     std::vector<char> tmpBuffer_ = std::vector<char>(1024);
     std::vector<char> result_;
     std::vector<char> specialResult_;
     Timeout timeout_;
     bool timeouted_;
     StringResultCallback cb_;
-    bool clearNewLines_;
+    BoolResultCallback statusCb_;
+    // Start of the running command, kept for the timeout log.
+    std::string command_;
+    // A command has one read and one timeout wait in flight, asio's own recycling keeps too few
+    // blocks for that plus the posted callbacks.
+    HandlerMemory readMemory_;
+    HandlerMemory timeoutMemory_;
 };
 
 #endif // SIM_800_HPP
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "socketTransport.hpp"
+
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/log/trivial.hpp>
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  constexpr std::chrono::seconds kConnectTimeout = 10s;
+  // Longer than a few TCP retransmissions, shorter than the kernel giving up on the connection.
+  constexpr std::chrono::seconds kSendTimeout = 10s;
+  constexpr std::chrono::milliseconds kAckPollInterval = 5ms;
+}
+
+SocketTransport::SocketTransport(boost::asio::io_service& ioService) : ioService_(ioService),
+resolver_(ioService),
+socket_(ioService),
+connectTimeout_(ioService),
+ackPoll_(ioService) {
+}
+
+const char* SocketTransport::GetName() const {
+  return "socket";
+}
+
+bool SocketTransport::IsReliable() const {
+  return true;
+}
+
+void SocketTransport::Connect(const std::string& address, std::size_t port, BoolResultCallback cb) {
+  boost::system::error_code ec;
+  socket_.close(ec);
+  connectCb_ = std::move(cb);
+  connectTimeout_.expires_from_now(kConnectTimeout);
+  connectTimeout_.async_wait(std::bind(&SocketTransport::OnConnectTimeout, this, std::placeholders::_1));
+  resolver_.async_resolve(address, std::to_string(port),
+    std::bind(&SocketTransport::OnResolve, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void SocketTransport::Send(const std::vector<char>& data, BoolResultCallback cb) {
+  sendData_.assign(data.begin(), data.end());
+  sendCb_ = std::move(cb);
+  sendDeadline_ = Timeout::clock_type::now() + kSendTimeout;
+  boost::asio::async_write(socket_, boost::asio::buffer(sendData_),
+    [this](const boost::system::error_code& error, std::size_t) { OnWrite(error); });
+}
+
+void SocketTransport::Receive(DataCallback cb) {
+  receiveCb_ = std::move(cb);
+  auto generation = receiveGeneration_;
+  socket_.async_read_some(boost::asio::buffer(receiveBuffer_), [this, generation](const boost::system::error_code& error, std::size_t size) {
+    if (generation != receiveGeneration_) {
+      return;
+    }
+    auto cb = std::move(receiveCb_);
+    if (error) {
+      if (error != boost::asio::error::operation_aborted) {
+        BOOST_LOG_TRIVIAL(error) << "Socket read failed: " << error.message();
+      }
+      cb(OptionalString());
+      return;
+    }
+    cb(OptionalString(std::string(receiveBuffer_.data(), size)));
+    });
+}
+
+void SocketTransport::CancelReceive() {
+  ++receiveGeneration_;
+  receiveCb_ = nullptr;
+  boost::system::error_code ec;
+  socket_.cancel(ec);
+}
+
+void SocketTransport::Close(BoolResultCallback cb) {
+  connectTimeout_.cancel();
+  ackPoll_.cancel();
+  resolver_.cancel();
+  boost::system::error_code ec;
+  socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+  socket_.close(ec);
+  ioService_.post(std::bind(cb, true));
+}
+
+void SocketTransport::OnResolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type endpoints) {
+  if (error) {
+    OnConnect(error);
+    return;
+  }
+  boost::asio::async_connect(socket_, endpoints,
+    [this](const boost::system::error_code& error, const boost::asio::ip::tcp::endpoint&) { OnConnect(error); });
+}
+
+void SocketTransport::OnConnect(const boost::system::error_code& error) {
+  connectTimeout_.cancel();
+  if (!connectCb_) {
+    return;
+  }
+  auto cb = std::move(connectCb_);
+  connectCb_ = nullptr;
+  if (error) {
+    BOOST_LOG_TRIVIAL(error) << "Socket connect failed: " << error.message();
+    cb(false);
+    return;
+  }
+  // Batches go out whole, nothing is gained by holding them back.
+  boost::system::error_code ec;
+  socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+  cb(true);
+}
+
+void SocketTransport::OnConnectTimeout(const boost::system::error_code& error) {
+  if (error || !connectCb_) {
+    return;
+  }
+  // The pending resolve or connect completes with an error and reports the failure.
+  resolver_.cancel();
+  boost::system::error_code ec;
+  socket_.close(ec);
+}
+
+void SocketTransport::OnWrite(const boost::system::error_code& error) {
+  if (error) {
+    BOOST_LOG_TRIVIAL(error) << "Socket write failed: " << error.message();
+    CompleteSend(false);
+    return;
+  }
+  CheckAcknowledged();
+}
+
+void SocketTransport::CheckAcknowledged() {
+  int pending = 0;
+  if (!socket_.is_open() || ::ioctl(socket_.native_handle(), SIOCOUTQ, &pending) != 0) {
+    CompleteSend(false);
+    return;
+  }
+  if (pending == 0) {
+    CompleteSend(true);
+    return;
+  }
+  // A reset or closed connection never gets its queue acknowledged, no point waiting for the timeout.
+  tcp_info info{};
+  socklen_t size = sizeof(info);
+  if (::getsockopt(socket_.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &size) != 0 || info.tcpi_state != TCP_ESTABLISHED) {
+    BOOST_LOG_TRIVIAL(error) << "Socket connection lost, " << pending << " bytes unacknowledged";
+    CompleteSend(false);
+    return;
+  }
+  if (Timeout::clock_type::now() >= sendDeadline_) {
+    BOOST_LOG_TRIVIAL(error) << "Socket send timed out, " << pending << " bytes unacknowledged";
+    CompleteSend(false);
+    return;
+  }
+  ackPoll_.expires_from_now(kAckPollInterval);
+  ackPoll_.async_wait([this](const boost::system::error_code& error) {
+    if (error) {
+      CompleteSend(false);
+      return;
+    }
+    CheckAcknowledged();
+    });
+}
+
+void SocketTransport::CompleteSend(bool result) {
+  auto cb = std::move(sendCb_);
+  sendCb_ = nullptr;
+  cb(result);
+}
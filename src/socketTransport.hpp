@@ -0,0 +1,59 @@
+#ifndef SOCKET_TRANSPORT_HPP
+#define SOCKET_TRANSPORT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/asio/high_resolution_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "transport.hpp"
+
+// A plain TCP socket over whatever network the host has besides the modem, Ethernet or Wi-Fi.
+//
+// A write completes as soon as the kernel has the data, long before it reaches the server, so a
+// send only counts as done once the kernel send queue is empty, i.e. the server acknowledged every
+// byte (SIOCOUTQ). A link that went away mid-send fails the send after a timeout instead of
+// reporting data that is still sitting in the socket buffer as delivered.
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(boost::asio::io_service& ioService);
+
+    const char* GetName() const override;
+    bool IsReliable() const override;
+    void Connect(const std::string& address, std::size_t port, BoolResultCallback cb) override;
+    void Send(const std::vector<char>& data, BoolResultCallback cb) override;
+    void Receive(DataCallback cb) override;
+    void CancelReceive() override;
+    void Close(BoolResultCallback cb) override;
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    void OnResolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type endpoints);
+    void OnConnect(const boost::system::error_code& error);
+    void OnConnectTimeout(const boost::system::error_code& error);
+    void OnWrite(const boost::system::error_code& error);
+    void CheckAcknowledged();
+    void CompleteSend(bool result);
+
+private:
+    boost::asio::io_service& ioService_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::ip::tcp::socket socket_;
+    Timeout connectTimeout_;
+    Timeout ackPoll_;
+    Timeout::time_point sendDeadline_;
+    std::vector<char> sendData_;
+    std::array<char, 1500> receiveBuffer_;
+    BoolResultCallback connectCb_;
+    BoolResultCallback sendCb_;
+    DataCallback receiveCb_;
+    // Bumped by CancelReceive(), the aborted read's completion is ignored.
+    std::uint64_t receiveGeneration_ = 0;
+};
+
+#endif // SOCKET_TRANSPORT_HPP
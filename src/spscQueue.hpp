@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock free queue for exactly one producer and one consumer thread.
+// Capacity is rounded up to a power of two, all storage is allocated up front.
+template<typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : buffer_(RoundUp(capacity)), mask_(buffer_.size() - 1) {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool TryPush(T value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+            return false;
+        }
+        buffer_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(buffer_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t Size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    std::size_t Capacity() const {
+        return buffer_.size();
+    }
+
+private:
+    static std::size_t RoundUp(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+private:
+    std::vector<T> buffer_;
+    const std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{ 0 };
+    alignas(64) std::atomic<std::size_t> tail_{ 0 };
+};
+
+#endif // SPSC_QUEUE_HPP
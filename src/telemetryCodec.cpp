@@ -0,0 +1,223 @@
+#include "telemetryCodec.hpp"
+
+#include <boost/log/trivial.hpp>
+#include <zlib.h>
+
+#include <algorithm>
+#include <ctime>
+
+
+namespace
+{
+  constexpr const char kNoneName[] = "none";
+  constexpr const char kDeflateDictName[] = "deflate-v1";
+  constexpr std::size_t kFrameHeaderSize = 2;
+  // Far above any frame we encode, a length prefix beyond it means the stream is out of step.
+  constexpr std::size_t kMaxFrameSize = 32 * 1024;
+  constexpr int kRawDeflateWindowBits = -15;
+  constexpr int kMemLevel = 8;
+
+  // Must be kept byte for byte in sync with TELEMETRY_DICTIONARY in utils/telemetryCodec.py.
+  // Deflate matches against the end of the dictionary best, so the most common strings go last.
+  constexpr const char kTelemetryDictionary[] =
+    "{\"ClientType\":\"SUBSCRIBER\"}{\"ClientType\":\"PUBLISHER\"}"
+    "0.1 0.2 0.3 0.4 0.5 0.6 0.7 0.8 0.9 1000.1 1010.2 1020.3 990.4 1005.5 "
+    "[{\"humidity\": 35.1, \"temperature\": 18.2, \"pressure\": 1001.3}, "
+    "{\"humidity\": 55.7, \"temperature\": 24.9, \"pressure\": 1012.6}]"
+    "{\"humidity\": 45.0625, \"temperature\": 21.35, \"pressure\": 1013.25}";
+
+  std::chrono::nanoseconds ThreadCpuTime() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+  }
+
+  const Bytef* DictionaryData() {
+    return reinterpret_cast<const Bytef*>(kTelemetryDictionary);
+  }
+
+  constexpr uInt DictionarySize() {
+    return sizeof(kTelemetryDictionary) - 1;
+  }
+}
+
+struct TelemetryCodec::Streams {
+  z_stream deflater{};
+  z_stream inflater{};
+  bool deflaterReady = false;
+  bool inflaterReady = false;
+
+  ~Streams() {
+    if (deflaterReady) {
+      deflateEnd(&deflater);
+    }
+    if (inflaterReady) {
+      inflateEnd(&inflater);
+    }
+  }
+};
+
+TelemetryCodec::TelemetryCodec(Type type) : type_(type), streams_(std::make_unique<Streams>()) {}
+
+TelemetryCodec::~TelemetryCodec() = default;
+
+std::string TelemetryCodec::TypeToString(Type type) {
+  switch (type) {
+  case Type::NONE:
+    return kNoneName;
+  case Type::DEFLATE_DICT:
+    return kDeflateDictName;
+  }
+  return "";
+}
+
+bool TelemetryCodec::TypeFromString(const std::string& name, Type& type) {
+  if (name == kNoneName) {
+    type = Type::NONE;
+    return true;
+  }
+  if (name == kDeflateDictName) {
+    type = Type::DEFLATE_DICT;
+    return true;
+  }
+  return false;
+}
+
+TelemetryCodec::Type TelemetryCodec::GetType() const {
+  return type_;
+}
+
+void TelemetryCodec::SetType(Type type) {
+  type_ = type;
+  pending_.clear();
+}
+
+bool TelemetryCodec::Encode(const std::vector<char>& payload, std::vector<char>& frame) {
+  auto cpuStart = ThreadCpuTime();
+  frame.clear();
+  if (type_ == Type::NONE) {
+    frame = payload;
+  }
+  else {
+    frame.resize(kFrameHeaderSize);
+    if (!Compress(payload, frame)) {
+      return false;
+    }
+    auto compressedSize = frame.size() - kFrameHeaderSize;
+    if (compressedSize > kMaxFrameSize) {
+      BOOST_LOG_TRIVIAL(error) << "Compressed frame too big: " << compressedSize;
+      return false;
+    }
+    frame[0] = static_cast<char>((compressedSize >> 8) & 0xFF);
+    frame[1] = static_cast<char>(compressedSize & 0xFF);
+  }
+  lastBatch_.batches = 1;
+  lastBatch_.inputBytes = payload.size();
+  lastBatch_.outputBytes = frame.size();
+  lastBatch_.cpuTime = ThreadCpuTime() - cpuStart;
+  total_.batches += lastBatch_.batches;
+  total_.inputBytes += lastBatch_.inputBytes;
+  total_.outputBytes += lastBatch_.outputBytes;
+  total_.cpuTime += lastBatch_.cpuTime;
+  return true;
+}
+
+bool TelemetryCodec::Decode(const std::string& chunk, FrameCallback cb) {
+  if (type_ == Type::NONE) {
+    cb(std::vector<char>(chunk.begin(), chunk.end()));
+    return true;
+  }
+  pending_.insert(pending_.end(), chunk.begin(), chunk.end());
+  std::vector<char> payload;
+  std::size_t offset = 0;
+  while (pending_.size() - offset >= kFrameHeaderSize) {
+    std::size_t frameSize = (static_cast<unsigned char>(pending_[offset]) << 8) |
+      static_cast<unsigned char>(pending_[offset + 1]);
+    // Raw deflate never produces an empty frame.
+    if (frameSize == 0 || frameSize > kMaxFrameSize) {
+      BOOST_LOG_TRIVIAL(error) << "Invalid frame length: " << frameSize;
+      pending_.clear();
+      return false;
+    }
+    if (pending_.size() - offset - kFrameHeaderSize < frameSize) {
+      break;
+    }
+    if (!Decompress(pending_.data() + offset + kFrameHeaderSize, frameSize, payload)) {
+      pending_.clear();
+      return false;
+    }
+    cb(payload);
+    offset += kFrameHeaderSize + frameSize;
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + offset);
+  return true;
+}
+
+const TelemetryCodec::Stats& TelemetryCodec::GetLastBatchStats() const {
+  return lastBatch_;
+}
+
+const TelemetryCodec::Stats& TelemetryCodec::GetTotalStats() const {
+  return total_;
+}
+
+bool TelemetryCodec::Compress(const std::vector<char>& input, std::vector<char>& output) {
+  auto& stream = streams_->deflater;
+  if (!streams_->deflaterReady) {
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, kRawDeflateWindowBits, kMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+      BOOST_LOG_TRIVIAL(error) << "deflateInit2 failed";
+      return false;
+    }
+    streams_->deflaterReady = true;
+  }
+  // Every frame is self contained, so a lost frame doesn't break the following ones.
+  if (deflateReset(&stream) != Z_OK || deflateSetDictionary(&stream, DictionaryData(), DictionarySize()) != Z_OK) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to prime deflate with dictionary";
+    return false;
+  }
+  auto offset = output.size();
+  output.resize(offset + deflateBound(&stream, input.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(output.data() + offset);
+  stream.avail_out = output.size() - offset;
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    BOOST_LOG_TRIVIAL(error) << "deflate failed: " << (stream.msg ? stream.msg : "");
+    return false;
+  }
+  output.resize(output.size() - stream.avail_out);
+  return true;
+}
+
+bool TelemetryCodec::Decompress(const char* input, std::size_t size, std::vector<char>& output) {
+  auto& stream = streams_->inflater;
+  if (!streams_->inflaterReady) {
+    if (inflateInit2(&stream, kRawDeflateWindowBits) != Z_OK) {
+      BOOST_LOG_TRIVIAL(error) << "inflateInit2 failed";
+      return false;
+    }
+    streams_->inflaterReady = true;
+  }
+  if (inflateReset(&stream) != Z_OK || inflateSetDictionary(&stream, DictionaryData(), DictionarySize()) != Z_OK) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to prime inflate with dictionary";
+    return false;
+  }
+  output.resize(std::max<std::size_t>(size * 8, 256));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+  stream.avail_in = size;
+  stream.next_out = reinterpret_cast<Bytef*>(output.data());
+  stream.avail_out = output.size();
+  int ret = Z_OK;
+  while ((ret = inflate(&stream, Z_NO_FLUSH)) == Z_OK && stream.avail_out == 0) {
+    auto produced = output.size();
+    output.resize(produced * 2);
+    stream.next_out = reinterpret_cast<Bytef*>(output.data() + produced);
+    stream.avail_out = output.size() - produced;
+  }
+  if (ret != Z_STREAM_END) {
+    BOOST_LOG_TRIVIAL(error) << "inflate failed: " << (stream.msg ? stream.msg : "");
+    return false;
+  }
+  output.resize(output.size() - stream.avail_out);
+  return true;
+}
@@ -0,0 +1,62 @@
+#ifndef TELEMETRY_CODEC_HPP
+#define TELEMETRY_CODEC_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compresses single uplink frames with raw deflate primed by a preset dictionary
+// of our telemetry JSON, so even 60 byte messages shrink. Every compressed frame
+// is prefixed with a 2 byte big endian length, as +IPD chunks don't preserve
+// frame boundaries.
+class TelemetryCodec {
+public:
+    enum class Type {
+        NONE = 0,
+        DEFLATE_DICT = 1,
+    };
+
+    struct Stats {
+        std::size_t batches = 0;
+        std::size_t inputBytes = 0;
+        std::size_t outputBytes = 0;
+        std::chrono::nanoseconds cpuTime{ 0 };
+    };
+
+    using FrameCallback = std::function<void(const std::vector<char>&)>;
+
+    explicit TelemetryCodec(Type type = Type::NONE);
+    ~TelemetryCodec();
+    TelemetryCodec(const TelemetryCodec&) = delete;
+    TelemetryCodec& operator=(const TelemetryCodec&) = delete;
+
+    static std::string TypeToString(Type type);
+    static bool TypeFromString(const std::string& name, Type& type);
+
+    Type GetType() const;
+    void SetType(Type type);
+
+    bool Encode(const std::vector<char>& payload, std::vector<char>& frame);
+    // Accepts arbitrary stream chunks and calls cb for each completed frame.
+    bool Decode(const std::string& chunk, FrameCallback cb);
+
+    const Stats& GetLastBatchStats() const;
+    const Stats& GetTotalStats() const;
+
+private:
+    bool Compress(const std::vector<char>& input, std::vector<char>& output);
+    bool Decompress(const char* input, std::size_t size, std::vector<char>& output);
+
+private:
+    struct Streams;
+    Type type_;
+    std::unique_ptr<Streams> streams_;
+    std::vector<char> pending_;
+    Stats lastBatch_;
+    Stats total_;
+};
+
+#endif // TELEMETRY_CODEC_HPP
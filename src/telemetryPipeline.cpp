@@ -0,0 +1,269 @@
+#include "telemetryPipeline.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <pthread.h>
+#include <string>
+
+#include "allocationGuard.hpp"
+#include "latencyProbe.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  constexpr std::chrono::milliseconds kDrainInterval = 100ms;
+  // Largest magnitude of any channel the decimator sees, the Bme280 pressure in Pa.
+  constexpr double kMaxSensorValue = 110000.0;
+
+  std::size_t DecimationFactor(const TelemetryPipeline::Config& config) {
+    auto factor = std::lround(config.sampleRate * std::chrono::duration<double>(config.sampleInterval).count());
+    return std::max(factor, 1L);
+  }
+
+  void SleepUntil(const timespec& deadline) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+  }
+
+  void AddNanoseconds(timespec& ts, long nanoseconds) {
+    ts.tv_nsec += nanoseconds;
+    while (ts.tv_nsec >= 1000000000L) {
+      ts.tv_nsec -= 1000000000L;
+      ++ts.tv_sec;
+    }
+  }
+
+  // Same text std::ostream produces for the values, formatted in place.
+  bool FormatSample(const TelemetryPipeline::Sample& sample, bool probe, std::vector<char>& payload) {
+    payload.resize(payload.capacity());
+    int size = 0;
+    if (probe) {
+      size = std::snprintf(payload.data(), payload.size(),
+        "{\"humidity\": %g, \"temperature\": %g, \"pressure\": %g, \"seq\": %u, \"sensedAt\": %lld}",
+        sample.data.humidity, sample.data.temperature, sample.data.pressure / 100.0, sample.seq,
+        static_cast<long long>(LatencyProbe::ToWallMicroseconds(sample.sampledAt)));
+    }
+    else {
+      size = std::snprintf(payload.data(), payload.size(), "{\"humidity\": %g, \"temperature\": %g, \"pressure\": %g}",
+        sample.data.humidity, sample.data.temperature, sample.data.pressure / 100.0);
+    }
+    if (size < 0 || static_cast<std::size_t>(size) >= payload.size()) {
+      return false;
+    }
+    payload.resize(size);
+    return true;
+  }
+
+  void ReportCodecStats(const TelemetryCodec& codec) {
+    const auto& batch = codec.GetLastBatchStats();
+    const auto& total = codec.GetTotalStats();
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+    BOOST_LOG_TRIVIAL(info) << "Codec " << TelemetryCodec::TypeToString(codec.GetType())
+      << ": batch " << batch.inputBytes << " -> " << batch.outputBytes << " bytes"
+      << " (ratio " << double(batch.inputBytes) / std::max<std::size_t>(batch.outputBytes, 1) << ")"
+      << " cpu " << duration_cast<microseconds>(batch.cpuTime).count() << " us"
+      << ", total " << total.inputBytes << " -> " << total.outputBytes << " bytes in " << total.batches << " batches"
+      << " cpu " << duration_cast<microseconds>(total.cpuTime).count() << " us";
+  }
+}
+
+TelemetryPipeline::Worker::Worker(std::size_t index, std::size_t capacity, int cpu, TelemetryCodec::Type codecType) :
+  executor("encoder" + std::to_string(index), 1, cpu < 0 ? std::vector<int>{} : std::vector<int>{ cpu }),
+  samples(capacity),
+  codec(codecType) {
+  payload.reserve(TelemetryPipeline::kMaxFrameSize);
+  // Room for the length prefix and deflate's worst case expansion.
+  frame.reserve(2 * TelemetryPipeline::kMaxFrameSize);
+}
+
+TelemetryPipeline::TelemetryPipeline(boost::asio::io_service& modemIoService, const Config& config) :
+  modemIoService_(modemIoService),
+  config_(config),
+  decimationExecutor_("decimation"),
+  drainTimeout_(decimationExecutor_.GetIoService()),
+  rawSamples_(config.rawQueueCapacity),
+  frames_(config.queueCapacity) {}
+
+TelemetryPipeline::~TelemetryPipeline() {
+  Stop();
+}
+
+bool TelemetryPipeline::Start(TelemetryCodec::Type codec, FramesReadyCallback framesReady) {
+  if (!CheckDecimation(config_)) {
+    return false;
+  }
+  bme280_ = std::make_unique<Bme280>();
+  if (!bme280_->Init()) {
+    BOOST_LOG_TRIVIAL(error) << "Bme280 init failed";
+    bme280_.reset();
+    return false;
+  }
+  framesReady_ = std::move(framesReady);
+  modemWork_ = std::make_unique<boost::asio::io_service::work>(modemIoService_);
+  for (std::size_t i = 0; i < std::max<std::size_t>(config_.workers, 1); ++i) {
+    int cpu = config_.workerCpus.empty() ? -1 : config_.workerCpus[i % config_.workerCpus.size()];
+    workers_.push_back(std::make_unique<Worker>(i, config_.queueCapacity, cpu, codec));
+    workers_.back()->executor.Start();
+    workers_.back()->executor.GetIoService().post(&AllocationGuard::TrackCurrentThread);
+  }
+  decimator_.Reset(DecimationFactor(config_), config_.decimationOrder);
+  BOOST_LOG_TRIVIAL(info) << "Sampling at " << config_.sampleRate << " Hz, decimation by " << decimator_.GetFactor()
+    << " with order " << config_.decimationOrder << " CIC";
+  decimationExecutor_.Start();
+  decimationExecutor_.GetIoService().post(&AllocationGuard::TrackCurrentThread);
+  decimationExecutor_.GetIoService().post(std::bind(&TelemetryPipeline::ScheduleDrain, this));
+  sampling_ = true;
+  samplerThread_ = std::thread(&TelemetryPipeline::SampleLoop, this);
+  return true;
+}
+
+void TelemetryPipeline::Stop() {
+  sampling_ = false;
+  if (samplerThread_.joinable()) {
+    samplerThread_.join();
+  }
+  decimationExecutor_.Stop();
+  for (auto& worker : workers_) {
+    worker->executor.Stop();
+  }
+  modemWork_.reset();
+}
+
+bool TelemetryPipeline::PopFrame(std::vector<char>& frame) {
+  FrameTimes times;
+  return PopFrame(frame, times);
+}
+
+bool TelemetryPipeline::PopFrame(std::vector<char>& frame, FrameTimes& times) {
+  Frame queued;
+  if (!frames_.TryPop(queued)) {
+    return false;
+  }
+  frame.assign(queued.data.begin(), queued.data.begin() + queued.size);
+  times = queued.times;
+  return true;
+}
+
+const TelemetryPipeline::Counters& TelemetryPipeline::GetCounters() const {
+  return counters_;
+}
+
+bool TelemetryPipeline::CheckDecimation(const Config& config) {
+  auto factor = DecimationFactor(config);
+  if (CicDecimator<3>::Fits(factor, config.decimationOrder, kMaxSensorValue)) {
+    return true;
+  }
+  BOOST_LOG_TRIVIAL(error) << "Decimation by " << factor << " with order " << config.decimationOrder
+    << " CIC overflows its integrators, lower the sample rate or the order";
+  return false;
+}
+
+void TelemetryPipeline::SampleLoop() {
+  pthread_setname_np(pthread_self(), "sampler");
+  Executor::PinCurrentThread(config_.sensorCpu);
+  AllocationGuard::TrackCurrentThread();
+  auto periodNs = static_cast<long>(1e9 / std::max(config_.sampleRate, 0.001));
+  timespec deadline{};
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  while (sampling_.load(std::memory_order_relaxed)) {
+    Sample sample{ bme280_->ReadSensorsData(), std::chrono::steady_clock::now() };
+    ++counters_.rawSamples;
+    if (!rawSamples_.TryPush(sample)) {
+      ++counters_.droppedRawSamples;
+    }
+    // Absolute deadlines keep the rate exact however long the i2c transfer took.
+    AddNanoseconds(deadline, periodNs);
+    SleepUntil(deadline);
+  }
+}
+
+void TelemetryPipeline::ScheduleDrain() {
+  drainTimeout_.expires_from_now(kDrainInterval);
+  drainTimeout_.async_wait(std::bind(&TelemetryPipeline::OnDrainTimeout, this, std::placeholders::_1));
+}
+
+void TelemetryPipeline::OnDrainTimeout(const boost::system::error_code& error) {
+  if (error) {
+    return;
+  }
+  Sample raw;
+  CicDecimator<3>::Values filtered;
+  while (rawSamples_.TryPop(raw)) {
+    if (decimator_.Push({ raw.data.temperature, raw.data.pressure, raw.data.humidity }, filtered)) {
+      Sample sample;
+      sample.data.temperature = filtered[0];
+      sample.data.pressure = filtered[1];
+      sample.data.humidity = filtered[2];
+      sample.sampledAt = raw.sampledAt;
+      sample.seq = nextSeq_++;
+      Dispatch(sample);
+    }
+  }
+  ScheduleDrain();
+}
+
+void TelemetryPipeline::Dispatch(const Sample& sample) {
+  ++counters_.samples;
+  auto& worker = *workers_[nextWorker_];
+  nextWorker_ = (nextWorker_ + 1) % workers_.size();
+  if (!worker.samples.TryPush(sample)) {
+    ++counters_.droppedSamples;
+    BOOST_LOG_TRIVIAL(warning) << "Encoder queue full, sample dropped";
+    return;
+  }
+  if (!worker.encodeScheduled.exchange(true, std::memory_order_acq_rel)) {
+    worker.executor.GetIoService().post(MakePooledHandler(worker.encodeMemory,
+      std::bind(&TelemetryPipeline::Encode, this, std::ref(worker))));
+  }
+}
+
+void TelemetryPipeline::Encode(Worker& worker) {
+  worker.encodeScheduled.exchange(false, std::memory_order_acq_rel);
+  Sample sample;
+  Frame frame;
+  while (worker.samples.TryPop(sample)) {
+    if (!FormatSample(sample, config_.probe, worker.payload)) {
+      BOOST_LOG_TRIVIAL(error) << "Failed to format data";
+      continue;
+    }
+    BOOST_LOG_TRIVIAL(info) << "Data: [ " << std::string(worker.payload.begin(), worker.payload.end()) << " ]";
+    if (!worker.codec.Encode(worker.payload, worker.frame)) {
+      BOOST_LOG_TRIVIAL(error) << "Failed to encode data";
+      continue;
+    }
+    ReportCodecStats(worker.codec);
+    if (worker.frame.size() > frame.data.size()) {
+      ++counters_.droppedFrames;
+      BOOST_LOG_TRIVIAL(error) << "Encoded frame too big: " << worker.frame.size();
+      continue;
+    }
+    std::copy(worker.frame.begin(), worker.frame.end(), frame.data.begin());
+    frame.size = worker.frame.size();
+    frame.times.sampledAt = sample.sampledAt;
+    frame.times.encodedAt = std::chrono::steady_clock::now();
+    if (!frames_.TryPush(frame)) {
+      ++counters_.droppedFrames;
+      BOOST_LOG_TRIVIAL(warning) << "Uplink queue full, frame dropped";
+      continue;
+    }
+    ++counters_.frames;
+    NotifyFramesReady();
+  }
+}
+
+void TelemetryPipeline::NotifyFramesReady() {
+  // One wakeup in flight is enough, the modem thread drains everything queued when it runs.
+  if (framesReadyScheduled_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  modemIoService_.post(MakePooledHandler(framesReadyMemory_, [this] {
+    framesReadyScheduled_.exchange(false, std::memory_order_acq_rel);
+    framesReady_();
+    }));
+}
@@ -0,0 +1,139 @@
+#ifndef TELEMETRY_PIPELINE_HPP
+#define TELEMETRY_PIPELINE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/high_resolution_timer.hpp>
+
+#include "bme280.hpp"
+#include "cicDecimator.hpp"
+#include "executor.hpp"
+#include "handlerMemory.hpp"
+#include "mpscQueue.hpp"
+#include "spscQueue.hpp"
+#include "telemetryCodec.hpp"
+
+// Sensor acquisition and encoding off the modem thread:
+//
+//   sampler thread --SpscQueue--> decimation executor --SpscQueue--> encoder worker (one queue each)
+//     --MpscQueue--> modem io_service
+//
+// The sampler reads the Bme280 at sampleRate on absolute monotonic deadlines and never allocates,
+// logs or waits on another stage. The CIC decimator low-pass filters the raw samples down to one
+// per sampleInterval for the uplink. Queues are bounded, when a stage falls behind the newest data
+// is dropped and counted. Frames travel inline in the queue cells and every buffer is reserved
+// when the pipeline starts, so the steady state doesn't allocate.
+class TelemetryPipeline {
+public:
+    using FramesReadyCallback = std::function<void()>;
+
+    // Largest encoded frame of a single sample.
+    static constexpr std::size_t kMaxFrameSize = 256;
+
+    struct Config {
+        // Uplink rate, one decimated sample per interval.
+        std::chrono::milliseconds sampleInterval{ 5000 };
+        double sampleRate = 25.0;
+        std::size_t decimationOrder = 3;
+        std::size_t rawQueueCapacity = 1024;
+        std::size_t workers = 2;
+        int sensorCpu = -1;
+        std::vector<int> workerCpus;
+        std::size_t queueCapacity = 64;
+        // Adds "seq" and "sensedAt" to every sample for the latency probe.
+        bool probe = false;
+    };
+
+    struct Sample {
+        Bme280::SensorsData data;
+        std::chrono::steady_clock::time_point sampledAt;
+        std::uint32_t seq = 0;
+    };
+
+    struct FrameTimes {
+        std::chrono::steady_clock::time_point sampledAt;
+        std::chrono::steady_clock::time_point encodedAt;
+    };
+
+    struct Counters {
+        std::atomic<std::size_t> rawSamples{ 0 };
+        std::atomic<std::size_t> droppedRawSamples{ 0 };
+        std::atomic<std::size_t> samples{ 0 };
+        std::atomic<std::size_t> droppedSamples{ 0 };
+        std::atomic<std::size_t> frames{ 0 };
+        std::atomic<std::size_t> droppedFrames{ 0 };
+    };
+
+    TelemetryPipeline(boost::asio::io_service& modemIoService, const Config& config);
+    ~TelemetryPipeline();
+
+    // framesReady is posted to the modem io_service whenever PopFrame has something new. false
+    // when the sensor doesn't respond, nothing is started then.
+    bool Start(TelemetryCodec::Type codec, FramesReadyCallback framesReady);
+    // false, with the reason logged, when the decimator's integrators would overflow at the
+    // configured rate and order. Start() refuses such a config.
+    static bool CheckDecimation(const Config& config);
+    void Stop();
+    bool PopFrame(std::vector<char>& frame);
+    bool PopFrame(std::vector<char>& frame, FrameTimes& times);
+    const Counters& GetCounters() const;
+
+private:
+    struct Frame {
+        std::array<char, kMaxFrameSize> data;
+        std::size_t size = 0;
+        FrameTimes times;
+    };
+
+    struct Worker {
+        Worker(std::size_t index, std::size_t capacity, int cpu, TelemetryCodec::Type codec);
+        Executor executor;
+        SpscQueue<Sample> samples;
+        TelemetryCodec codec;
+        std::vector<char> payload;
+        std::vector<char> frame;
+        // At most one Encode is posted at a time, it drains everything queued.
+        std::atomic<bool> encodeScheduled{ false };
+        HandlerMemory encodeMemory;
+    };
+
+    void SampleLoop();
+    void ScheduleDrain();
+    void OnDrainTimeout(const boost::system::error_code& error);
+    void Dispatch(const Sample& sample);
+    void Encode(Worker& worker);
+    void NotifyFramesReady();
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    boost::asio::io_service& modemIoService_;
+    // Keeps the modem io_service running while it waits for the first frames.
+    std::unique_ptr<boost::asio::io_service::work> modemWork_;
+    Config config_;
+    Executor decimationExecutor_;
+    Timeout drainTimeout_;
+    std::unique_ptr<Bme280> bme280_;
+    std::thread samplerThread_;
+    std::atomic<bool> sampling_{ false };
+    SpscQueue<Sample> rawSamples_;
+    CicDecimator<3> decimator_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::size_t nextWorker_ = 0;
+    std::uint32_t nextSeq_ = 0;
+    MpscQueue<Frame> frames_;
+    FramesReadyCallback framesReady_;
+    std::atomic<bool> framesReadyScheduled_{ false };
+    HandlerMemory framesReadyMemory_;
+    Counters counters_;
+};
+
+#endif // TELEMETRY_PIPELINE_HPP
@@ -0,0 +1,35 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <cstddef>
+#include <experimental/optional>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A byte stream connection to the server, whatever carries it. The client protocol (handshake,
+// codec frames) runs on top and doesn't know which link it goes over.
+class Transport {
+public:
+    using BoolResultCallback = std::function<void(bool)>;
+    using OptionalString = std::experimental::optional<std::string>;
+    using DataCallback = std::function<void(OptionalString)>;
+
+    virtual ~Transport() = default;
+
+    virtual const char* GetName() const = 0;
+    // false when data can get lost on the way without the transport noticing.
+    virtual bool IsReliable() const = 0;
+    // Brings the link up if it needs to and opens the connection to the server.
+    virtual void Connect(const std::string& address, std::size_t port, BoolResultCallback cb) = 0;
+    // cb(true) once data has left the client, one send at a time.
+    virtual void Send(const std::vector<char>& data, BoolResultCallback cb) = 0;
+    // Next chunk from the server, nullopt when the connection failed or was closed.
+    virtual void Receive(DataCallback cb) = 0;
+    // Abandons a pending Receive(), its callback is not called. Not while a Send() is in flight.
+    virtual void CancelReceive() = 0;
+    // Drops the connection in whatever state it is in.
+    virtual void Close(BoolResultCallback cb) = 0;
+};
+
+#endif // TRANSPORT_HPP
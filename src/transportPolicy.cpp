@@ -0,0 +1,397 @@
+#include "transportPolicy.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  // How often the cheaper transports are retried while a more expensive one carries the traffic.
+  constexpr std::chrono::seconds kUpgradeInterval = 30s;
+  // Handshakes sent over an unreliable transport before it is given up.
+  constexpr std::size_t kHandshakeAttempts = 4;
+
+  long long ToMilliseconds(TransportPolicy::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  }
+
+  void IgnoreResult(bool) {
+  }
+}
+
+TransportPolicy::TransportPolicy(boost::asio::io_service& ioService, const Config& config) : ioService_(ioService),
+config_(config),
+retryDelay_(config.retryInterval),
+retryTimeout_(ioService),
+upgradeTimeout_(ioService) {
+  auto handshake = ClientProtocol::BuildHandshake(config_.clientType, config_.offeredCodec);
+  handshake_.assign(handshake.begin(), handshake.end());
+}
+
+void TransportPolicy::Add(std::unique_ptr<Transport> transport) {
+  Entry entry;
+  entry.transport = std::move(transport);
+  entry.handshakeTimeout = std::make_unique<Timeout>(ioService_);
+  entries_.push_back(std::move(entry));
+}
+
+void TransportPolicy::Start(ReadyCallback ready) {
+  readyCb_ = std::move(ready);
+  StartRound(0);
+}
+
+void TransportPolicy::Send(const std::vector<char>& data, Transport::BoolResultCallback cb) {
+  if (standby_ != kNone) {
+    SwitchToStandby();
+  }
+  if (active_ == kNone) {
+    ioService_.post(std::bind(cb, false));
+    return;
+  }
+  entries_[active_].transport->Send(data, std::move(cb));
+}
+
+void TransportPolicy::Receive(Transport::DataCallback cb) {
+  if (standby_ != kNone) {
+    SwitchToStandby();
+  }
+  if (active_ == kNone) {
+    ioService_.post(std::bind(cb, Transport::OptionalString()));
+    return;
+  }
+  auto& entry = entries_[active_];
+  if (!entry.leftover.empty()) {
+    ioService_.post(std::bind(cb, Transport::OptionalString(std::move(entry.leftover))));
+    entry.leftover.clear();
+    return;
+  }
+  entry.transport->Receive(std::move(cb));
+}
+
+void TransportPolicy::CancelReceive() {
+  if (active_ != kNone) {
+    entries_[active_].transport->CancelReceive();
+  }
+}
+
+bool TransportPolicy::FailOver() {
+  if (closing_ || active_ == kNone) {
+    return false;
+  }
+  auto failed = active_;
+  BOOST_LOG_TRIVIAL(warning) << "Transport " << entries_[failed].transport->GetName()
+    << (entries_.size() > 1 ? " failed, failing over" : " failed, reconnecting");
+  ++entries_[failed].failures;
+  Deactivate();
+  failingOver_ = true;
+  failedAt_ = Clock::now();
+  upgradeTimeout_.cancel();
+  if (standby_ != kNone) {
+    auto standby = standby_;
+    standby_ = kNone;
+    ioService_.post([this, standby]() { Activate(standby); });
+    return true;
+  }
+  // The only transport is connected again once its close is through.
+  if (entries_.size() == 1) {
+    StartRound(failed);
+    return true;
+  }
+  roundStart_ = failed;
+  ConnectNext(failed);
+  return true;
+}
+
+void TransportPolicy::Close(Transport::BoolResultCallback cb) {
+  closing_ = true;
+  retryTimeout_.cancel();
+  upgradeTimeout_.cancel();
+  connectAfterClose_ = kNone;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    auto state = entries_[i].state;
+    if (i != active_ && (state == State::CONNECTING || state == State::READY)) {
+      CloseEntry(i, IgnoreResult);
+    }
+  }
+  if (active_ == kNone) {
+    ioService_.post(std::bind(cb, true));
+    return;
+  }
+  entries_[active_].transport->Close(std::move(cb));
+}
+
+TelemetryCodec::Type TransportPolicy::GetCodec() const {
+  return codec_;
+}
+
+const char* TransportPolicy::GetActiveName() const {
+  return active_ == kNone ? "none" : entries_[active_].transport->GetName();
+}
+
+void TransportPolicy::Report() const {
+  auto now = Clock::now();
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    const auto& entry = entries_[i];
+    auto activeTime = entry.activeTime + (i == active_ ? now - activeSince_ : Clock::duration::zero());
+    BOOST_LOG_TRIVIAL(info) << "Transport " << entry.transport->GetName() << (i == active_ ? " (active)" : "")
+      << ": carried traffic for " << ToMilliseconds(activeTime) / 1000.0 << " s"
+      << ", connects " << entry.connects << ", failures " << entry.failures;
+  }
+  BOOST_LOG_TRIVIAL(info) << "Transport switchovers " << switchovers_ << ", last " << ToMilliseconds(lastSwitchover_)
+    << " ms, longest " << ToMilliseconds(longestSwitchover_) << " ms";
+}
+
+void TransportPolicy::Connect(std::size_t index, bool background) {
+  auto& entry = entries_[index];
+  BOOST_LOG_TRIVIAL(info) << "Connecting over " << entry.transport->GetName() << (background ? " in the background" : "");
+  entry.state = State::CONNECTING;
+  entry.background = background;
+  entry.leftover.clear();
+  entry.transport->Connect(config_.serverAddress, config_.serverPort,
+    std::bind(&TransportPolicy::OnConnected, this, index, ++entry.attempt, std::placeholders::_1));
+}
+
+bool TransportPolicy::IsCurrent(std::size_t index, std::uint64_t attempt) const {
+  return entries_[index].state == State::CONNECTING && entries_[index].attempt == attempt;
+}
+
+void TransportPolicy::OnConnected(std::size_t index, std::uint64_t attempt, bool result) {
+  if (!IsCurrent(index, attempt)) {
+    return;
+  }
+  if (!result) {
+    OnFailed(index, "connection failed");
+    return;
+  }
+  entries_[index].handshakesSent = 1;
+  entries_[index].transport->Send(handshake_, std::bind(&TransportPolicy::OnHandshakeSend, this, index, attempt, std::placeholders::_1));
+}
+
+void TransportPolicy::OnHandshakeSend(std::size_t index, std::uint64_t attempt, bool result) {
+  if (!IsCurrent(index, attempt)) {
+    return;
+  }
+  if (!result) {
+    OnFailed(index, "failed to send handshake");
+    return;
+  }
+  auto& entry = entries_[index];
+  entry.handshakeTimeout->expires_from_now(entry.transport->IsReliable() ? config_.handshakeTimeout : config_.handshakeRetransmitInterval);
+  entry.handshakeTimeout->async_wait(std::bind(&TransportPolicy::OnHandshakeTimeout, this, index, attempt, std::placeholders::_1));
+  entry.transport->Receive(std::bind(&TransportPolicy::OnHandshakeResponse, this, index, attempt, std::placeholders::_1));
+}
+
+void TransportPolicy::OnHandshakeTimeout(std::size_t index, std::uint64_t attempt, const boost::system::error_code& error) {
+  if (error || !IsCurrent(index, attempt)) {
+    return;
+  }
+  // A resend or the close goes to the modem too, nothing may still be reading from it.
+  auto& entry = entries_[index];
+  entry.transport->CancelReceive();
+  if (!entry.transport->IsReliable() && entry.handshakesSent < kHandshakeAttempts) {
+    BOOST_LOG_TRIVIAL(warning) << "No handshake reply over " << entry.transport->GetName() << ", sending it again";
+    ++entry.handshakesSent;
+    entry.transport->Send(handshake_, std::bind(&TransportPolicy::OnHandshakeSend, this, index, attempt, std::placeholders::_1));
+    return;
+  }
+  OnFailed(index, "handshake timed out");
+}
+
+void TransportPolicy::OnHandshakeResponse(std::size_t index, std::uint64_t attempt, Transport::OptionalString result) {
+  if (!IsCurrent(index, attempt)) {
+    return;
+  }
+  auto& entry = entries_[index];
+  entry.handshakeTimeout->cancel();
+  // Only the reply line is parsed, relayed frames may follow it in the same chunk.
+  auto replySize = result ? ClientProtocol::HandshakeReplySize(result.value(), config_.offeredCodec) : 0;
+  auto negotiated = TelemetryCodec::Type::NONE;
+  if (!result || !ClientProtocol::ParseHandshakeReply(result->substr(0, replySize), config_.offeredCodec, negotiated)) {
+    OnFailed(index, "failed to handshake");
+    return;
+  }
+  // The pipeline keeps encoding with the first codec, frames can't change codec mid stream.
+  if (hasCodec_ && negotiated != codec_) {
+    OnFailed(index, "server negotiated another codec");
+    return;
+  }
+  codec_ = negotiated;
+  hasCodec_ = true;
+  entry.leftover = result->substr(replySize);
+  ++entry.connects;
+  OnReady(index);
+}
+
+void TransportPolicy::OnReady(std::size_t index) {
+  auto& entry = entries_[index];
+  entry.state = State::READY;
+  if (active_ == kNone) {
+    Activate(index);
+    return;
+  }
+  if (index < active_ && standby_ == kNone) {
+    BOOST_LOG_TRIVIAL(warning) << "Transport " << entry.transport->GetName() << " is back, taking over at the next send";
+    standby_ = index;
+    standbyReadySince_ = Clock::now();
+    return;
+  }
+  // Something at least as cheap took over while this one was connecting.
+  CloseEntry(index, IgnoreResult);
+}
+
+void TransportPolicy::OnFailed(std::size_t index, const char* reason) {
+  auto& entry = entries_[index];
+  BOOST_LOG_TRIVIAL(error) << "Transport " << entry.transport->GetName() << ": " << reason;
+  ++entry.failures;
+  if (!started_ && entries_.size() == 1) {
+    CloseEntry(index, [this](bool) { readyCb_(false); });
+    return;
+  }
+  CloseEntry(index, IgnoreResult);
+  // A failed background attempt waits for the next upgrade round.
+  if (active_ == kNone) {
+    ConnectNext(index);
+  }
+}
+
+void TransportPolicy::CloseEntry(std::size_t index, Transport::BoolResultCallback cb) {
+  auto& entry = entries_[index];
+  entry.handshakeTimeout->cancel();
+  entry.state = State::CLOSING;
+  auto attempt = ++entry.attempt;
+  entry.transport->Close([this, index, attempt, cb = std::move(cb)](bool result) {
+    OnEntryClosed(index, attempt);
+    cb(result);
+  });
+}
+
+void TransportPolicy::OnEntryClosed(std::size_t index, std::uint64_t attempt) {
+  auto& entry = entries_[index];
+  if (entry.state != State::CLOSING || entry.attempt != attempt) {
+    return;
+  }
+  entry.state = State::DOWN;
+  if (connectAfterClose_ != index) {
+    return;
+  }
+  connectAfterClose_ = kNone;
+  if (!closing_ && active_ == kNone) {
+    Connect(index, false);
+  }
+}
+
+void TransportPolicy::StartRound(std::size_t index) {
+  roundStart_ = index;
+  if (entries_[index].state == State::DOWN) {
+    Connect(index, false);
+    return;
+  }
+  if (entries_[index].state == State::CLOSING) {
+    connectAfterClose_ = index;
+    return;
+  }
+  ConnectNext(index);
+}
+
+void TransportPolicy::ConnectNext(std::size_t index) {
+  if (closing_) {
+    return;
+  }
+  for (auto i = (index + 1) % entries_.size(); i != roundStart_; i = (i + 1) % entries_.size()) {
+    if (entries_[i].state == State::DOWN) {
+      Connect(i, false);
+      return;
+    }
+    // Its close is still talking to the modem, a connect now would interleave the commands.
+    if (entries_[i].state == State::CLOSING) {
+      connectAfterClose_ = i;
+      return;
+    }
+  }
+  // A transport still connecting goes on with the round when it fails.
+  if (std::any_of(entries_.begin(), entries_.end(), [](const Entry& entry) { return entry.state == State::CONNECTING; })) {
+    return;
+  }
+  ScheduleRetry();
+}
+
+void TransportPolicy::Activate(std::size_t index) {
+  active_ = index;
+  activeSince_ = Clock::now();
+  retryDelay_ = config_.retryInterval;
+  const char* name = entries_[index].transport->GetName();
+  if (failingOver_) {
+    failingOver_ = false;
+    RecordSwitchover(activeSince_ - failedAt_);
+    BOOST_LOG_TRIVIAL(warning) << "Failed over to " << name << " in " << ToMilliseconds(lastSwitchover_) << " ms";
+  }
+  else {
+    BOOST_LOG_TRIVIAL(info) << "Connected over " << name;
+  }
+  started_ = true;
+  ScheduleUpgrade();
+  readyCb_(true);
+}
+
+void TransportPolicy::SwitchToStandby() {
+  auto from = entries_[active_].transport->GetName();
+  auto standby = standby_;
+  standby_ = kNone;
+  Deactivate();
+  active_ = standby;
+  activeSince_ = Clock::now();
+  RecordSwitchover(activeSince_ - standbyReadySince_);
+  BOOST_LOG_TRIVIAL(warning) << "Switched from " << from << " back to " << entries_[active_].transport->GetName()
+    << " in " << ToMilliseconds(lastSwitchover_) << " ms";
+  ScheduleUpgrade();
+}
+
+void TransportPolicy::Deactivate() {
+  auto index = active_;
+  entries_[index].activeTime += Clock::now() - activeSince_;
+  active_ = kNone;
+  CloseEntry(index, IgnoreResult);
+}
+
+void TransportPolicy::ScheduleRetry() {
+  BOOST_LOG_TRIVIAL(error) << "No transport connected, retrying in " << retryDelay_.count() << " ms";
+  retryTimeout_.expires_from_now(retryDelay_);
+  retryTimeout_.async_wait(std::bind(&TransportPolicy::OnRetryTimeout, this, std::placeholders::_1));
+  retryDelay_ = std::min(retryDelay_ * 2, std::max(config_.maxRetryInterval, config_.retryInterval));
+}
+
+void TransportPolicy::OnRetryTimeout(const boost::system::error_code& error) {
+  if (error || closing_ || active_ != kNone) {
+    return;
+  }
+  StartRound(0);
+}
+
+void TransportPolicy::ScheduleUpgrade() {
+  if (active_ == 0) {
+    upgradeTimeout_.cancel();
+    return;
+  }
+  upgradeTimeout_.expires_from_now(kUpgradeInterval);
+  upgradeTimeout_.async_wait(std::bind(&TransportPolicy::OnUpgradeTimeout, this, std::placeholders::_1));
+}
+
+void TransportPolicy::OnUpgradeTimeout(const boost::system::error_code& error) {
+  if (error || closing_ || active_ == kNone || standby_ != kNone) {
+    return;
+  }
+  for (std::size_t i = 0; i < active_; ++i) {
+    if (entries_[i].state == State::DOWN) {
+      Connect(i, true);
+    }
+  }
+  ScheduleUpgrade();
+}
+
+void TransportPolicy::RecordSwitchover(Clock::duration duration) {
+  ++switchovers_;
+  lastSwitchover_ = duration;
+  longestSwitchover_ = std::max(longestSwitchover_, duration);
+}
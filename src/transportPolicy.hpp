@@ -0,0 +1,161 @@
+#ifndef TRANSPORT_POLICY_HPP
+#define TRANSPORT_POLICY_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/high_resolution_timer.hpp>
+#include <boost/asio/io_service.hpp>
+
+#include "clientProtocol.hpp"
+#include "telemetryCodec.hpp"
+#include "transport.hpp"
+
+// Keeps the client connected to the server over the cheapest transport that works.
+//
+// Transports are added cheapest first. Start() connects and handshakes the first one that comes
+// up. When a send or receive fails the owner calls FailOver() and keeps queueing: the next
+// transport in order is brought up, or the only one reconnected, and ready fires again, the owner
+// then resends whatever was in flight. While a more expensive transport carries the traffic the cheaper ones are retried in the
+// background; one that comes back takes over at the next Send() or Receive(), so nothing in flight
+// is cut off, and the expensive one is closed.
+//
+// A transport that failed is closed before it is connected again, a GPRS CIPSHUT has to finish
+// before the next command goes to the modem. A round of connects that gets back to where it
+// started without any transport ready waits for the retry interval.
+//
+// Frames the server relays right behind the handshake reply arrive in the same chunk, they are
+// handed to the first Receive() on that transport.
+//
+// Switchover time is measured from the failure to the replacement being ready, and from a cheaper
+// transport being ready to taking over when switching back.
+class TransportPolicy {
+public:
+    using Clock = std::chrono::steady_clock;
+    // true whenever a transport is ready for data, at the start and after every failover. false
+    // when the only transport failed to connect.
+    using ReadyCallback = std::function<void(bool result)>;
+
+    struct Config {
+        ClientProtocol::ClientType clientType = ClientProtocol::ClientType::PUBLISHER;
+        TelemetryCodec::Type offeredCodec = TelemetryCodec::Type::NONE;
+        std::string serverAddress;
+        std::size_t serverPort = 0;
+        // A server that doesn't answer the handshake within this fails the transport.
+        std::chrono::milliseconds handshakeTimeout{ 10000 };
+        // Over an unreliable transport the handshake is sent again after this, a few times.
+        std::chrono::milliseconds handshakeRetransmitInterval{ 3000 };
+        // Pause before going through every transport again once none could be connected, doubled
+        // after every round that failed up to maxRetryInterval.
+        std::chrono::milliseconds retryInterval{ 10000 };
+        std::chrono::milliseconds maxRetryInterval{ 10000 };
+    };
+
+    TransportPolicy(boost::asio::io_service& ioService, const Config& config);
+
+    // Cheapest first, before Start().
+    void Add(std::unique_ptr<Transport> transport);
+    void Start(ReadyCallback ready);
+    void Send(const std::vector<char>& data, Transport::BoolResultCallback cb);
+    void Receive(Transport::DataCallback cb);
+    // Abandons a Receive() on the active transport.
+    void CancelReceive();
+    // After a failed Send() or Receive() on the active transport. The only transport is closed and
+    // connected again. false while closing, the owner gives up as before.
+    bool FailOver();
+    void Close(Transport::BoolResultCallback cb);
+
+    // Codec negotiated on the first connection, later ones have to agree with it.
+    TelemetryCodec::Type GetCodec() const;
+    const char* GetActiveName() const;
+    void Report() const;
+
+private:
+    static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+    enum class State {
+        DOWN,
+        CONNECTING,
+        READY,
+        // Close() in flight, connected again once it completes.
+        CLOSING,
+    };
+
+    struct Entry {
+        std::unique_ptr<Transport> transport;
+        State state = State::DOWN;
+        // Bumped by every connect and close, callbacks of an older attempt are ignored.
+        std::uint64_t attempt = 0;
+        std::size_t handshakesSent = 0;
+        // Stream data that came in behind the handshake reply.
+        std::string leftover;
+        // Cheaper transport retried while a more expensive one is active.
+        bool background = false;
+        std::size_t connects = 0;
+        std::size_t failures = 0;
+        Clock::duration activeTime{};
+        std::unique_ptr<boost::asio::high_resolution_timer> handshakeTimeout;
+    };
+
+    void Connect(std::size_t index, bool background);
+    bool IsCurrent(std::size_t index, std::uint64_t attempt) const;
+    void OnConnected(std::size_t index, std::uint64_t attempt, bool result);
+    void OnHandshakeSend(std::size_t index, std::uint64_t attempt, bool result);
+    void OnHandshakeResponse(std::size_t index, std::uint64_t attempt, Transport::OptionalString result);
+    void OnHandshakeTimeout(std::size_t index, std::uint64_t attempt, const boost::system::error_code& error);
+    void OnReady(std::size_t index);
+    void OnFailed(std::size_t index, const char* reason);
+    // Closes a transport that isn't active, cb once it is DOWN again.
+    void CloseEntry(std::size_t index, Transport::BoolResultCallback cb);
+    void OnEntryClosed(std::size_t index, std::uint64_t attempt);
+    // Starts a round of connects at index, which is tried first.
+    void StartRound(std::size_t index);
+    // Connects the next DOWN transport after index, wrapping around, until the round is back at
+    // its start.
+    void ConnectNext(std::size_t index);
+    void Activate(std::size_t index);
+    void SwitchToStandby();
+    void Deactivate();
+    void ScheduleRetry();
+    void OnRetryTimeout(const boost::system::error_code& error);
+    void ScheduleUpgrade();
+    void OnUpgradeTimeout(const boost::system::error_code& error);
+    void RecordSwitchover(Clock::duration duration);
+
+private:
+    using Timeout = boost::asio::high_resolution_timer;
+
+    boost::asio::io_service& ioService_;
+    Config config_;
+    std::vector<char> handshake_;
+    std::vector<Entry> entries_;
+    std::size_t active_ = kNone;
+    std::size_t standby_ = kNone;
+    // Where the current round of connects started.
+    std::size_t roundStart_ = 0;
+    // Next in the round, waiting for its close to complete.
+    std::size_t connectAfterClose_ = kNone;
+    Clock::time_point activeSince_;
+    Clock::time_point standbyReadySince_;
+    bool started_ = false;
+    bool closing_ = false;
+    bool hasCodec_ = false;
+    TelemetryCodec::Type codec_ = TelemetryCodec::Type::NONE;
+    ReadyCallback readyCb_;
+    // Set from the failure until a replacement is ready.
+    bool failingOver_ = false;
+    Clock::time_point failedAt_;
+    std::size_t switchovers_ = 0;
+    Clock::duration lastSwitchover_{};
+    Clock::duration longestSwitchover_{};
+    std::chrono::milliseconds retryDelay_;
+    Timeout retryTimeout_;
+    Timeout upgradeTimeout_;
+};
+
+#endif // TRANSPORT_POLICY_HPP
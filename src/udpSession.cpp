@@ -0,0 +1,125 @@
+#include "udpSession.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+
+namespace
+{
+  constexpr char kDatagramTag = 'D';
+  constexpr char kAckTag = 'A';
+  constexpr std::size_t kAckSize = 9;
+  constexpr uint32_t kBitmapBits = 32;
+
+  void PutBigEndian(std::vector<char>& out, uint64_t value, std::size_t bytes) {
+    for (std::size_t i = bytes; i > 0; --i) {
+      out.push_back(static_cast<char>((value >> ((i - 1) * 8)) & 0xFF));
+    }
+  }
+
+  uint32_t GetBigEndian32(const char* in) {
+    uint32_t value = 0;
+    for (std::size_t i = 0; i < 4; ++i) {
+      value = (value << 8) | static_cast<unsigned char>(in[i]);
+    }
+    return value;
+  }
+
+  // Sequence numbers wrap, so compare them the way TCP does.
+  bool SeqBefore(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) < 0;
+  }
+}
+
+UdpSession::UdpSession(std::size_t bufferedDatagrams) : bufferedDatagrams_(bufferedDatagrams) {}
+
+const std::vector<char>& UdpSession::Wrap(const std::vector<char>& payload) {
+  using namespace std::chrono;
+  auto timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+  lastDatagram_.clear();
+  lastDatagram_.push_back(kDatagramTag);
+  PutBigEndian(lastDatagram_, nextSeq_, 4);
+  PutBigEndian(lastDatagram_, timestamp, 8);
+  lastDatagram_.insert(lastDatagram_.end(), payload.begin(), payload.end());
+
+  if (unacked_.size() == bufferedDatagrams_) {
+    ++counters_.abandoned;
+    unacked_.pop_front();
+  }
+  unacked_.push_back({ nextSeq_, nextSeq_, false, lastDatagram_ });
+  ++nextSeq_;
+  ++counters_.sent;
+  return lastDatagram_;
+}
+
+bool UdpSession::OnAck(const std::string& data) {
+  if (data.size() % kAckSize != 0) {
+    BOOST_LOG_TRIVIAL(error) << "Malformed ack of size " << data.size();
+    return false;
+  }
+  for (std::size_t offset = 0; offset < data.size(); offset += kAckSize) {
+    if (data[offset] != kAckTag) {
+      BOOST_LOG_TRIVIAL(error) << "Unexpected ack tag";
+      return false;
+    }
+    ++counters_.acksReceived;
+    ApplyAck(GetBigEndian32(data.data() + offset + 1), GetBigEndian32(data.data() + offset + 5));
+  }
+  return true;
+}
+
+void UdpSession::ApplyAck(uint32_t cumulativeSeq, uint32_t bitmap) {
+  uint32_t highestReceived = cumulativeSeq;
+  for (uint32_t bit = 0; bit < kBitmapBits; ++bit) {
+    if (bitmap & (1u << bit)) {
+      highestReceived = cumulativeSeq + 1 + bit;
+    }
+  }
+  auto isReceived = [cumulativeSeq, bitmap](uint32_t seq) {
+    if (!SeqBefore(cumulativeSeq, seq)) {
+      return true;
+    }
+    auto bit = seq - cumulativeSeq - 1;
+    return bit < kBitmapBits && (bitmap & (1u << bit));
+  };
+
+  for (auto& datagram : unacked_) {
+    // Anything sent after the highest received seq may still be in flight.
+    if (isReceived(datagram.seq) || !SeqBefore(datagram.lostAfter, highestReceived) || datagram.retransmitQueued) {
+      continue;
+    }
+    datagram.retransmitQueued = true;
+    retransmits_.push_back(datagram.seq);
+    ++counters_.lossDetected;
+  }
+
+  auto acked = std::remove_if(unacked_.begin(), unacked_.end(), [&isReceived](const Datagram& datagram) {
+    return isReceived(datagram.seq);
+    });
+  counters_.acked += std::distance(acked, unacked_.end());
+  unacked_.erase(acked, unacked_.end());
+}
+
+bool UdpSession::NextRetransmit(std::vector<char>& datagram) {
+  while (!retransmits_.empty()) {
+    auto seq = retransmits_.front();
+    retransmits_.pop_front();
+    auto it = std::find_if(unacked_.begin(), unacked_.end(), [seq](const Datagram& d) { return d.seq == seq; });
+    if (it == unacked_.end()) {
+      continue;
+    }
+    // A retransmission can be lost as well, let a later ack queue it again.
+    it->retransmitQueued = false;
+    it->lostAfter = nextSeq_ - 1;
+    datagram = it->data;
+    ++counters_.retransmitted;
+    return true;
+  }
+  return false;
+}
+
+const UdpSession::Counters& UdpSession::GetCounters() const {
+  return counters_;
+}
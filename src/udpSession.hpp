@@ -0,0 +1,54 @@
+#ifndef UDP_SESSION_HPP
+#define UDP_SESSION_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Sequencing and selective retransmission for the UDP publish mode.
+//
+// Datagram: 'D' | seq (u32 BE) | timestamp ms since epoch (u64 BE) | payload
+// Ack:      'A' | cumulative seq (u32 BE) | bitmap (u32 BE)
+// Every seq up to the cumulative one is received, bit i of the bitmap
+// marks seq cumulative + 1 + i as received too.
+class UdpSession {
+public:
+    struct Counters {
+        std::size_t sent = 0;
+        std::size_t retransmitted = 0;
+        std::size_t acked = 0;
+        std::size_t lossDetected = 0;
+        std::size_t abandoned = 0;
+        std::size_t acksReceived = 0;
+    };
+
+    explicit UdpSession(std::size_t bufferedDatagrams = 64);
+
+    const std::vector<char>& Wrap(const std::vector<char>& payload);
+    bool OnAck(const std::string& data);
+    bool NextRetransmit(std::vector<char>& datagram);
+    const Counters& GetCounters() const;
+
+private:
+    struct Datagram {
+        uint32_t seq;
+        // Lost once an ack shows a later seq received without it. A retransmission goes out
+        // behind everything sent before it, only acks of datagrams after that can tell.
+        uint32_t lostAfter;
+        bool retransmitQueued;
+        std::vector<char> data;
+    };
+
+    void ApplyAck(uint32_t cumulativeSeq, uint32_t bitmap);
+
+private:
+    std::size_t bufferedDatagrams_;
+    uint32_t nextSeq_ = 1;
+    std::deque<Datagram> unacked_;
+    std::deque<uint32_t> retransmits_;
+    std::vector<char> lastDatagram_;
+    Counters counters_;
+};
+
+#endif // UDP_SESSION_HPP
@@ -0,0 +1,100 @@
+#define BOOST_TEST_MODULE batchController
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+#include "batchController.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  // SEND OK latency of a link that costs a round trip plus a serialisation time per byte.
+  struct SimulatedLink {
+    double fixedMs;
+    double perByteMs;
+
+    std::chrono::milliseconds Latency(std::size_t bytes) const {
+      return std::chrono::milliseconds(static_cast<long>(fixedMs + perByteMs * bytes));
+    }
+  };
+
+  // Sends batches of whatever size the controller currently asks for.
+  BatchController::Decision Send(BatchController& controller, const SimulatedLink& link, std::size_t count) {
+    auto decision = BatchController::Decision::HOLD;
+    for (std::size_t i = 0; i < count; ++i) {
+      auto bytes = controller.GetBatchSize();
+      decision = controller.OnSendCompleted(bytes, link.Latency(bytes), true);
+    }
+    return decision;
+  }
+
+  // drains of framesPerDrain frames, the pipeline hands them over with one timestamp each.
+  void Queue(BatchController& controller, std::size_t drains, std::size_t framesPerDrain, std::size_t frameSize,
+    BatchController::Clock::duration period) {
+    auto now = BatchController::Clock::time_point();
+    for (std::size_t drain = 0; drain < drains; ++drain, now += period) {
+      for (std::size_t frame = 0; frame < framesPerDrain; ++frame) {
+        controller.OnDataQueued(frameSize, now);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GrowsWhileTheRoundTripDominates)
+{
+  BatchController controller;
+  SimulatedLink link{ 800.0, 0.1 };
+  Send(controller, link, 20);
+  const auto& metrics = controller.GetMetrics();
+  BOOST_TEST(controller.GetBatchSize() == BatchController::Config().maxBatchSize);
+  BOOST_TEST(metrics.fixedLatencyMs == 800.0, boost::test_tools::tolerance(0.01));
+  BOOST_TEST(metrics.perByteMs == 0.1, boost::test_tools::tolerance(0.05));
+}
+
+BOOST_AUTO_TEST_CASE(HoldsOnceTheBytesDominate)
+{
+  BatchController controller;
+  SimulatedLink link{ 100.0, 2.0 };
+  auto decision = Send(controller, link, 20);
+  // The first send looks like round trip only, the second one reveals the per byte cost.
+  BOOST_TEST(controller.GetBatchSize() == 384u);
+  BOOST_TEST((decision == BatchController::Decision::HOLD));
+}
+
+BOOST_AUTO_TEST_CASE(FailuresAndPoorSignalShrink)
+{
+  BatchController controller;
+  SimulatedLink link{ 800.0, 0.1 };
+  Send(controller, link, 20);
+  BOOST_TEST((controller.OnSendCompleted(1024, 0ms, false) == BatchController::Decision::SHRINK));
+  BOOST_TEST(controller.GetBatchSize() == 512u);
+  BOOST_TEST((controller.OnLinkQuality(5, true) == BatchController::Decision::SHRINK));
+  BOOST_TEST(controller.GetBatchSize() == 256u);
+  // On a poor link successful sends hold the size instead of growing it back.
+  Send(controller, link, 5);
+  BOOST_TEST(controller.GetBatchSize() == 256u);
+  BOOST_TEST(controller.GetMetrics().failures == 1u);
+}
+
+BOOST_AUTO_TEST_CASE(LatencySpikeShrinks)
+{
+  BatchController controller;
+  SimulatedLink link{ 800.0, 0.1 };
+  Send(controller, link, 20);
+  auto bytes = controller.GetBatchSize();
+  BOOST_TEST((controller.OnSendCompleted(bytes, 4 * link.Latency(bytes), true) == BatchController::Decision::SHRINK));
+  BOOST_TEST(controller.GetBatchSize() == bytes / 2);
+}
+
+BOOST_AUTO_TEST_CASE(ArrivalRateCountsEveryFrameOfADrain)
+{
+  BatchController controller;
+  // 5 frames of 10 bytes every 500 ms is 100 B/s.
+  Queue(controller, 100, 5, 10, 500ms);
+  BOOST_TEST(controller.GetMetrics().arrivalBps == 100.0, boost::test_tools::tolerance(0.01));
+  // A 256 byte batch fills up in 2.56 s at that rate.
+  BOOST_TEST(controller.GetFlushInterval().count() == 2560);
+}
@@ -0,0 +1,33 @@
+#define BOOST_TEST_MODULE clientProtocol
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "clientProtocol.hpp"
+
+
+namespace
+{
+  const auto kDeflate = TelemetryCodec::Type::DEFLATE_DICT;
+  const auto kNone = TelemetryCodec::Type::NONE;
+}
+
+BOOST_AUTO_TEST_CASE(HandshakeReplyNegotiatesTheOfferedCodec)
+{
+  auto negotiated = kNone;
+  BOOST_TEST(ClientProtocol::ParseHandshakeReply("OK deflate-v1\r\n", kDeflate, negotiated));
+  BOOST_TEST((negotiated == kDeflate));
+  BOOST_TEST(ClientProtocol::ParseHandshakeReply("OK", kDeflate, negotiated));
+  BOOST_TEST((negotiated == kNone));
+  BOOST_TEST(!ClientProtocol::ParseHandshakeReply("ERROR", kDeflate, negotiated));
+}
+
+BOOST_AUTO_TEST_CASE(HandshakeReplySizeEndsAtTheReplyLine)
+{
+  std::string frame = "{\"seq\": 1}";
+  BOOST_TEST(ClientProtocol::HandshakeReplySize("OK" + frame, kNone) == 2u);
+  BOOST_TEST(ClientProtocol::HandshakeReplySize("OK\r\n" + frame, kNone) == 4u);
+  BOOST_TEST(ClientProtocol::HandshakeReplySize("OK deflate-v1", kDeflate) == 13u);
+  BOOST_TEST(ClientProtocol::HandshakeReplySize("OK deflate-v1\n" + std::string("\x00\x05", 2), kDeflate) == 14u);
+  BOOST_TEST(ClientProtocol::HandshakeReplySize("OK deflate-v1\r\n", kDeflate) == 15u);
+}
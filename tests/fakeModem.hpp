@@ -0,0 +1,190 @@
+#ifndef FAKE_MODEM_HPP
+#define FAKE_MODEM_HPP
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "extendedSerialPort.hpp"
+#include "scopedFd.hpp"
+
+// SIM800 on the other end of a pty, just enough of it for TCP sends and slow clock sleep. Commands
+// are echoed, the peer acknowledges every segment before the next CIPACK. With slow clock enabled
+// a high DTR puts it to sleep, it ignores the UART until DTR goes low again.
+class FakeModem {
+public:
+    static constexpr std::size_t kSegmentSize = 256;
+
+    FakeModem() {
+        int master = -1;
+        int slave = -1;
+        BOOST_REQUIRE(openpty(&master, &slave, nullptr, nullptr, nullptr) == 0);
+        master_.reset(master);
+        slave_.reset(slave);
+        termios raw{};
+        tcgetattr(slave, &raw);
+        cfmakeraw(&raw);
+        tcsetattr(slave, TCSANOW, &raw);
+    }
+
+    ~FakeModem() {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Hands the slave side to the port and starts answering.
+    void Attach(ExtendedSerialPort& port) {
+        port.assign(slave_.release());
+        thread_ = std::thread(&FakeModem::Serve, this);
+    }
+
+    void RefuseLeavingQuickSend() {
+        refuseLeavingQuickSend_ = true;
+    }
+
+    void SetDtr(bool high) {
+        dtrHigh_ = high;
+        Log(high ? "DTR high" : "DTR low");
+    }
+
+    bool IsAsleep() const {
+        return slowClock_ && dtrHigh_;
+    }
+
+    // Commands and DTR changes in the order the modem saw them.
+    std::vector<std::string> GetEvents() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return events_;
+    }
+
+    std::vector<std::string> GetCommands() {
+        auto commands = GetEvents();
+        commands.erase(std::remove_if(commands.begin(), commands.end(), [](const std::string& event) {
+            return event.compare(0, 2, "AT") != 0;
+        }), commands.end());
+        return commands;
+    }
+
+    std::vector<std::size_t> GetSegments() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return segments_;
+    }
+
+    std::string GetPayload() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return payload_;
+    }
+
+private:
+    void Serve() {
+        std::string buffer;
+        char chunk[512];
+        while (running_) {
+            pollfd descriptor{ master_.get(), POLLIN, 0 };
+            if (poll(&descriptor, 1, 10) <= 0) {
+                continue;
+            }
+            auto size = read(master_.get(), chunk, sizeof(chunk));
+            if (size <= 0) {
+                continue;
+            }
+            if (IsAsleep()) {
+                Log("ignored while asleep");
+                continue;
+            }
+            buffer.append(chunk, size);
+            while (Handle(buffer)) {
+            }
+        }
+    }
+
+    // Consumes one command or payload from buffer, false when it is incomplete.
+    bool Handle(std::string& buffer) {
+        if (pendingPayload_ > 0) {
+            if (buffer.size() < pendingPayload_) {
+                return false;
+            }
+            auto size = pendingPayload_;
+            pendingPayload_ = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                payload_.append(buffer, 0, size);
+                segments_.push_back(size);
+            }
+            buffer.erase(0, size);
+            sent_ += size;
+            Write(quickSend_ ? "\r\nDATA ACCEPT:" + std::to_string(size) + "\r\n" : "\r\nSEND OK\r\n");
+            return true;
+        }
+        auto end = buffer.find("\r\n");
+        if (end == std::string::npos) {
+            return false;
+        }
+        auto command = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        Log(command);
+        auto echo = command + "\r";
+        if (command == "AT+CIPSEND?") {
+            Write(echo + "\r\n+CIPSEND: " + std::to_string(kSegmentSize) + "\r\n\r\nOK\r\n");
+        }
+        else if (command.compare(0, 11, "AT+CIPSEND=") == 0) {
+            pendingPayload_ = std::stoul(command.substr(11));
+            Write(echo + "\r\n> ");
+        }
+        else if (command == "AT+CIPQSEND=1") {
+            quickSend_ = true;
+            Write(echo + "\r\nOK\r\n");
+        }
+        else if (command == "AT+CIPQSEND=0") {
+            quickSend_ = refuseLeavingQuickSend_;
+            Write(echo + (refuseLeavingQuickSend_ ? "\r\nERROR\r\n" : "\r\nOK\r\n"));
+        }
+        else if (command == "AT+CIPACK") {
+            Write(echo + "\r\n+CIPACK: " + std::to_string(sent_) + "," + std::to_string(sent_) + ",0\r\n\r\nOK\r\n");
+        }
+        else {
+            slowClock_ = command == "AT+CSCLK=1" || (slowClock_ && command != "AT+CSCLK=0");
+            Write(echo + "\r\nOK\r\n");
+        }
+        return true;
+    }
+
+    void Log(const std::string& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(event);
+    }
+
+    void Write(const std::string& data) {
+        BOOST_REQUIRE(write(master_.get(), data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    }
+
+    ScopedFd master_;
+    ScopedFd slave_;
+    std::thread thread_;
+    std::atomic<bool> running_{ true };
+    std::atomic<bool> dtrHigh_{ false };
+    std::atomic<bool> slowClock_{ false };
+    bool refuseLeavingQuickSend_ = false;
+    bool quickSend_ = false;
+    std::size_t pendingPayload_ = 0;
+    std::size_t sent_ = 0;
+    std::mutex mutex_;
+    std::vector<std::string> events_;
+    std::vector<std::size_t> segments_;
+    std::string payload_;
+};
+
+#endif // FAKE_MODEM_HPP
@@ -0,0 +1,90 @@
+#define BOOST_TEST_MODULE gprs
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "extendedSerialPort.hpp"
+#include "fakeModem.hpp"
+#include "gprs.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  constexpr std::size_t kSegmentSize = FakeModem::kSegmentSize;
+
+  struct GprsFixture {
+    GprsFixture() : port(ioService), gprs(port) {
+    }
+
+    // Sends data, true when the callback reported success.
+    bool Send(const std::vector<char>& data) {
+      modem.Attach(port);
+      std::size_t calls = 0;
+      bool result = false;
+      gprs.SendData(data, [&](bool sent) {
+        ++calls;
+        result = sent;
+      });
+      for (auto deadline = std::chrono::steady_clock::now() + 5s; calls == 0 && std::chrono::steady_clock::now() < deadline;) {
+        ioService.run_one_for(100ms);
+      }
+      BOOST_TEST(calls == 1u);
+      return result;
+    }
+
+    std::vector<char> Payload(std::size_t size) {
+      std::vector<char> data(size);
+      for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + i % 26);
+      }
+      return data;
+    }
+
+    boost::asio::io_service ioService;
+    FakeModem modem;
+    ExtendedSerialPort port;
+    Gprs gprs;
+  };
+}
+
+BOOST_FIXTURE_TEST_CASE(LargePayloadGoesOutInSegments, GprsFixture)
+{
+  // Above the 1460 bytes assumed before the modem is asked for its CIPSEND limit.
+  auto data = Payload(3000);
+  BOOST_TEST(Send(data));
+  BOOST_TEST(modem.GetPayload() == std::string(data.begin(), data.end()));
+  auto segments = modem.GetSegments();
+  BOOST_TEST(segments.size() == 12u);
+  BOOST_TEST(*std::max_element(segments.begin(), segments.end()) <= kSegmentSize);
+  // Quick send is switched on for the segments and off again for the single CIPSENDs.
+  auto commands = modem.GetCommands();
+  auto on = std::find(commands.begin(), commands.end(), "AT+CIPQSEND=1");
+  auto off = std::find(commands.begin(), commands.end(), "AT+CIPQSEND=0");
+  BOOST_TEST((on < off));
+  BOOST_TEST((off != commands.end()));
+}
+
+BOOST_FIXTURE_TEST_CASE(DeliveryIsReportedWhenLeavingQuickSendFails, GprsFixture)
+{
+  modem.RefuseLeavingQuickSend();
+  auto data = Payload(2000);
+  // Every byte was acknowledged, the mode switch is retried on the next connection.
+  BOOST_TEST(Send(data));
+  BOOST_TEST(modem.GetPayload().size() == data.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(SmallPayloadIsASingleSend, GprsFixture)
+{
+  auto data = Payload(100);
+  BOOST_TEST(Send(data));
+  BOOST_TEST(modem.GetSegments() == std::vector<std::size_t>{ 100 });
+  auto commands = modem.GetCommands();
+  BOOST_TEST((std::find(commands.begin(), commands.end(), "AT+CIPQSEND=1") == commands.end()));
+}
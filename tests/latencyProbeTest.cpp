@@ -0,0 +1,92 @@
+#define BOOST_TEST_MODULE latencyProbe
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latencyProbe.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  std::string Sample(int seq) {
+    return "{\"seq\": " + std::to_string(seq) + ", \"sensedAt\": " +
+      std::to_string(LatencyProbe::ToWallMicroseconds(LatencyProbe::Clock::now())) + "}";
+  }
+
+  std::vector<char> ToFrame(const std::string& text) {
+    return std::vector<char>(text.begin(), text.end());
+  }
+
+  // A publisher probe, batches come out stamped like the app sends them.
+  struct Publisher {
+    Publisher() {
+      probe.Start(TelemetryCodec::Type::NONE);
+    }
+
+    std::vector<char> Batch(std::initializer_list<int> seqs) {
+      std::string batch;
+      for (auto seq : seqs) {
+        batch += Sample(seq);
+      }
+      return probe.StampBatch(ToFrame(batch));
+    }
+
+    LatencyProbe probe;
+  };
+}
+
+BOOST_AUTO_TEST_CASE(CountsMissingReorderedAndDuplicates)
+{
+  Publisher publisher;
+  LatencyProbe subscriber;
+  subscriber.OnFrame(publisher.Batch({ 0, 1, 3 }));
+  subscriber.OnFrame(publisher.Batch({ 2, 2, 6 }));
+  const auto& counters = subscriber.GetCounters();
+  BOOST_TEST(counters.received == 6u);
+  BOOST_TEST(counters.missing == 2u);
+  BOOST_TEST(counters.reordered == 1u);
+  BOOST_TEST(counters.duplicates == 1u);
+  BOOST_TEST(counters.restarts == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(RestartedPublisherIsNoDuplicate)
+{
+  LatencyProbe subscriber;
+  {
+    Publisher publisher;
+    subscriber.OnFrame(publisher.Batch({ 0, 1, 2, 3, 4 }));
+  }
+  std::this_thread::sleep_for(1ms);
+  Publisher restarted;
+  subscriber.OnFrame(restarted.Batch({ 0, 1, 2 }));
+  const auto& counters = subscriber.GetCounters();
+  BOOST_TEST(counters.restarts == 1u);
+  BOOST_TEST(counters.duplicates == 0u);
+  BOOST_TEST(counters.reordered == 0u);
+  BOOST_TEST(counters.received == 8u);
+}
+
+BOOST_AUTO_TEST_CASE(ObjectsSplitAcrossFramesAreJoined)
+{
+  Publisher publisher;
+  LatencyProbe subscriber;
+  auto batch = publisher.Batch({ 0, 1 });
+  // Cut inside the stamp and inside the second sample.
+  auto stampEnd = std::find(batch.begin(), batch.end(), '}');
+  std::vector<char> first(batch.begin(), stampEnd - 3);
+  std::vector<char> second(stampEnd - 3, batch.end() - 5);
+  std::vector<char> third(batch.end() - 5, batch.end());
+  BOOST_TEST(subscriber.OnFrame(first));
+  BOOST_TEST(subscriber.OnFrame(second));
+  BOOST_TEST(subscriber.OnFrame(third));
+  BOOST_TEST(subscriber.GetCounters().received == 2u);
+  BOOST_TEST(subscriber.GetCounters().missing == 0u);
+  // A stamp on its own is not telemetry.
+  BOOST_TEST(!subscriber.OnFrame(publisher.Batch({})));
+}
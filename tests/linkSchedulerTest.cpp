@@ -0,0 +1,164 @@
+#define BOOST_TEST_MODULE linkScheduler
+#include <boost/test/unit_test.hpp>
+
+#include <wiringPi.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "extendedSerialPort.hpp"
+#include "fakeModem.hpp"
+#include "gprs.hpp"
+#include "linkScheduler.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  using Clock = LinkScheduler::Clock;
+
+  constexpr int kDtrPin = 7;
+  constexpr std::chrono::milliseconds kMaxLatency = 400ms;
+
+  FakeModem* gModem = nullptr;
+
+  // Position of the nth (from 0) occurrence of event, events.size() when there isn't one.
+  std::size_t Find(const std::vector<std::string>& events, const std::string& event, std::size_t nth = 0) {
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      if (events[i] == event && nth-- == 0) {
+        return i;
+      }
+    }
+    return events.size();
+  }
+
+  struct SchedulerFixture {
+    struct Window {
+      Clock::time_point queuedAt;
+      Clock::time_point openedAt;
+      bool sent = false;
+    };
+
+    SchedulerFixture() : port(ioService), gprs(port), scheduler(ioService, gprs, { kMaxLatency, kDtrPin }) {
+      gModem = &modem;
+      modem.Attach(port);
+    }
+
+    ~SchedulerFixture() {
+      gModem = nullptr;
+    }
+
+    // Enables slow clock, true once the modem is asleep.
+    bool Start() {
+      bool done = false;
+      bool result = false;
+      scheduler.Start(std::bind(&SchedulerFixture::OnWindowOpen, this, std::placeholders::_1), [&](bool started) {
+        done = true;
+        result = started;
+      });
+      RunUntil(done);
+      return result && modem.IsAsleep();
+    }
+
+    // Queues a frame while the modem sleeps and sends it in the window that opens for it, like the
+    // publisher does.
+    Window Queue() {
+      window = Window();
+      closed = false;
+      window.queuedAt = Clock::now();
+      scheduler.OnDataQueued();
+      RunUntil(closed);
+      return window;
+    }
+
+    void OnWindowOpen(bool result) {
+      window.openedAt = Clock::now();
+      if (!result) {
+        closed = true;
+        return;
+      }
+      gprs.SendData(payload, [this](bool sent) {
+        window.sent = sent;
+        scheduler.OnDataSent();
+        scheduler.CloseWindow();
+        closed = true;
+      });
+    }
+
+    void RunUntil(const bool& done) {
+      ioService.restart();
+      for (auto deadline = Clock::now() + 5s; !done && Clock::now() < deadline;) {
+        ioService.run_one_for(100ms);
+      }
+      BOOST_REQUIRE(done);
+    }
+
+    boost::asio::io_service ioService;
+    FakeModem modem;
+    ExtendedSerialPort port;
+    Gprs gprs;
+    LinkScheduler scheduler;
+    std::vector<char> payload = std::vector<char>(60, 'x');
+    Window window;
+    bool closed = false;
+  };
+}
+
+// wiringPi, the DTR pin is wired to the fake modem.
+void pinMode(int, int) {
+}
+
+void digitalWrite(int pin, int value) {
+  if (gModem && pin == kDtrPin) {
+    gModem->SetDtr(value == HIGH);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(SendWhileAsleepWakesTheModemFirst, SchedulerFixture)
+{
+  BOOST_REQUIRE(Start());
+  auto events = modem.GetEvents();
+  // Slow clock is on before DTR lets the modem sleep.
+  BOOST_TEST(Find(events, "AT+CSCLK=1") < Find(events, "DTR high"));
+
+  auto window = Queue();
+  BOOST_TEST(window.sent);
+  BOOST_TEST(modem.GetPayload() == std::string(payload.begin(), payload.end()));
+  events = modem.GetEvents();
+  // DTR low, the modem answers AT, then the data goes out and the modem is put back to sleep.
+  auto woken = Find(events, "DTR low", 1);
+  auto alive = Find(events, "AT");
+  auto send = Find(events, "AT+CIPSEND=" + std::to_string(payload.size()));
+  BOOST_TEST(woken < alive);
+  BOOST_TEST(alive < send);
+  BOOST_TEST(send < Find(events, "DTR high", 1));
+  BOOST_TEST(Find(events, "ignored while asleep") == events.size());
+  BOOST_TEST(modem.IsAsleep());
+}
+
+BOOST_FIXTURE_TEST_CASE(WakeLeadConvergesAheadOfTheDeadline, SchedulerFixture)
+{
+  BOOST_REQUIRE(Start());
+  const auto& stats = scheduler.GetStats();
+  auto initialLead = stats.wakeLead;
+  for (int i = 0; i < 16; ++i) {
+    auto window = Queue();
+    BOOST_TEST(window.sent);
+    // The window is open before the frame's delivery deadline.
+    BOOST_TEST((window.openedAt <= window.queuedAt + kMaxLatency));
+  }
+  BOOST_TEST_MESSAGE("wake-to-send " << stats.lastWakeToSend.count() << " ms, wake lead " << stats.wakeLead.count() << " ms");
+  // DTR needs 100 ms to settle before the modem answers.
+  BOOST_TEST((stats.lastWakeToSend >= 100ms));
+  BOOST_TEST((stats.wakeLead < initialLead));
+  // Settles on the measured wake-to-send plus the margin.
+  BOOST_TEST(std::abs((stats.wakeLead - stats.lastWakeToSend - 200ms).count()) < 50);
+
+  BOOST_TEST(stats.windows == 16u);
+  BOOST_TEST((stats.awake > Clock::duration::zero()));
+  BOOST_TEST((stats.asleep > Clock::duration::zero()));
+}
@@ -0,0 +1,106 @@
+#define BOOST_TEST_MODULE pipelineQueue
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "mpscQueue.hpp"
+#include "spscQueue.hpp"
+
+
+namespace
+{
+  constexpr std::uint32_t kItems = 200000;
+}
+
+BOOST_AUTO_TEST_CASE(SpscQueueIsBoundedFifo)
+{
+  SpscQueue<int> queue(5);
+  BOOST_TEST(queue.Capacity() == 8u);
+  for (int i = 0; i < 8; ++i) {
+    BOOST_TEST(queue.TryPush(i));
+  }
+  // Full, the newest value is the one dropped.
+  BOOST_TEST(!queue.TryPush(8));
+  BOOST_TEST(queue.Size() == 8u);
+  int value = -1;
+  for (int i = 0; i < 8; ++i) {
+    BOOST_TEST(queue.TryPop(value));
+    BOOST_TEST(value == i);
+  }
+  BOOST_TEST(!queue.TryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(SpscQueueKeepsOrderAcrossThreads)
+{
+  SpscQueue<std::uint32_t> queue(64);
+  std::thread producer([&queue]() {
+    for (std::uint32_t i = 0; i < kItems; ++i) {
+      while (!queue.TryPush(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  std::uint32_t expected = 0;
+  bool ordered = true;
+  while (expected < kItems) {
+    std::uint32_t value = 0;
+    if (!queue.TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ordered = ordered && value == expected;
+    ++expected;
+  }
+  producer.join();
+  BOOST_TEST(ordered);
+}
+
+BOOST_AUTO_TEST_CASE(MpscQueueKeepsEveryProducersOrder)
+{
+  constexpr std::uint32_t kProducers = 3;
+  MpscQueue<std::uint64_t> queue(64);
+  std::vector<std::thread> producers;
+  for (std::uint32_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (std::uint32_t i = 0; i < kItems; ++i) {
+        while (!queue.TryPush((std::uint64_t(p) << 32) | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<std::uint32_t> next(kProducers, 0);
+  bool ordered = true;
+  for (std::uint64_t received = 0; received < kProducers * kItems;) {
+    std::uint64_t value = 0;
+    if (!queue.TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto producer = value >> 32;
+    ordered = ordered && producer < kProducers && (value & 0xFFFFFFFF) == next[producer];
+    ++next[producer];
+    ++received;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  BOOST_TEST(ordered);
+  std::uint64_t value = 0;
+  BOOST_TEST(!queue.TryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(MpscQueueRejectsWhenFull)
+{
+  MpscQueue<int> queue(4);
+  for (int i = 0; i < 4; ++i) {
+    BOOST_TEST(queue.TryPush(i));
+  }
+  BOOST_TEST(!queue.TryPush(4));
+  int value = -1;
+  BOOST_TEST(queue.TryPop(value));
+  BOOST_TEST(value == 0);
+  BOOST_TEST(queue.TryPush(4));
+}
@@ -0,0 +1,193 @@
+#define BOOST_TEST_MODULE serialTrace
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "extendedSerialPort.hpp"
+#include "fakeModem.hpp"
+#include "gprs.hpp"
+#include "serialTrace.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  std::string TracePath(const char* test) {
+    return "/tmp/rpiclient-test-" + std::string(test) + "-" + std::to_string(getpid()) + ".trace";
+  }
+
+  void RunUntil(boost::asio::io_service& ioService, const bool& done) {
+    ioService.restart();
+    for (auto deadline = std::chrono::steady_clock::now() + 5s; !done && std::chrono::steady_clock::now() < deadline;) {
+      ioService.run_one_for(100ms);
+    }
+    BOOST_REQUIRE(done);
+  }
+
+  // What the publisher does with the modem, in short: a liveness check and a send.
+  struct Session {
+    explicit Session(boost::asio::io_service& ioService) : ioService(ioService), port(ioService), gprs(port) {
+    }
+
+    bool Run(const std::vector<char>& data) {
+      bool done = false;
+      bool result = false;
+      gprs.CheckAlive([&](bool alive) {
+        if (!alive) {
+          done = true;
+          return;
+        }
+        gprs.SendData(data, [&](bool sent) {
+          result = sent;
+          done = true;
+        });
+      });
+      RunUntil(ioService, done);
+      return result;
+    }
+
+    boost::asio::io_service& ioService;
+    ExtendedSerialPort port;
+    Gprs gprs;
+  };
+
+  // Counts the allocations asio makes through a handler's allocator.
+  template<typename T>
+  struct CountingAllocator {
+    using value_type = T;
+
+    explicit CountingAllocator(std::size_t& count) : count(&count) {
+    }
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : count(other.count) {
+    }
+
+    T* allocate(std::size_t n) {
+      ++*count;
+      return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* pointer, std::size_t n) {
+      std::allocator<T>().deallocate(pointer, n);
+    }
+
+    template<typename U>
+    bool operator==(const CountingAllocator<U>& other) const {
+      return count == other.count;
+    }
+
+    template<typename U>
+    bool operator!=(const CountingAllocator<U>& other) const {
+      return count != other.count;
+    }
+
+    std::size_t* count;
+  };
+
+  struct CountedReadHandler {
+    using allocator_type = CountingAllocator<CountedReadHandler>;
+
+    allocator_type get_allocator() const {
+      return allocator_type(*allocations);
+    }
+
+    void operator()(const boost::system::error_code& error, std::size_t size) {
+      *read = error ? 0 : size;
+      *done = true;
+    }
+
+    std::size_t* allocations;
+    std::size_t* read;
+    bool* done;
+  };
+}
+
+BOOST_AUTO_TEST_CASE(WrittenRecordsLoadBack)
+{
+  auto path = TracePath("records");
+  {
+    SerialTrace::Writer writer;
+    BOOST_REQUIRE(writer.Open(path));
+    writer.Record(SerialTrace::Direction::TX, "AT\r\n", 4);
+    writer.Record(SerialTrace::Direction::RX, "AT\r\r\nOK\r\n", 9);
+  }
+  std::vector<SerialTrace::Record> records;
+  BOOST_REQUIRE(SerialTrace::Load(path, records));
+  std::remove(path.c_str());
+  BOOST_REQUIRE(records.size() == 2u);
+  BOOST_TEST((records[0].direction == SerialTrace::Direction::TX));
+  BOOST_TEST(std::string(records[0].data.begin(), records[0].data.end()) == "AT\r\n");
+  BOOST_TEST((records[1].direction == SerialTrace::Direction::RX));
+  BOOST_TEST(std::string(records[1].data.begin(), records[1].data.end()) == "AT\r\r\nOK\r\n");
+  BOOST_TEST(records[0].timestampNs == 0u);
+  BOOST_TEST(records[1].timestampNs >= records[0].timestampNs);
+}
+
+BOOST_AUTO_TEST_CASE(RecordedSessionReplays)
+{
+  auto path = TracePath("session");
+  std::vector<char> data(100, 'x');
+  {
+    boost::asio::io_service ioService;
+    FakeModem modem;
+    Session recorded(ioService);
+    modem.Attach(recorded.port);
+    BOOST_REQUIRE(recorded.port.StartRecording(path));
+    BOOST_REQUIRE(recorded.Run(data));
+  }
+  {
+    // The same session against the trace, no modem needed.
+    boost::asio::io_service ioService;
+    Session replayed(ioService);
+    BOOST_REQUIRE(replayed.port.StartReplay(path, true));
+    BOOST_TEST(replayed.Run(data));
+    BOOST_TEST(replayed.port.GetReplayMismatches() == 0u);
+  }
+  {
+    // Another payload size goes out as another CIPSEND.
+    boost::asio::io_service ioService;
+    Session diverging(ioService);
+    BOOST_REQUIRE(diverging.port.StartReplay(path, true));
+    diverging.Run(std::vector<char>(99, 'x'));
+    BOOST_TEST(diverging.port.GetReplayMismatches() > 0u);
+  }
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(RecorderKeepsTheHandlerAllocator)
+{
+  auto path = TracePath("allocator");
+  boost::asio::io_service ioService;
+  FakeModem modem;
+  ExtendedSerialPort port(ioService);
+  modem.Attach(port);
+  BOOST_REQUIRE(port.StartRecording(path));
+
+  std::size_t allocations = 0;
+  std::size_t read = 0;
+  bool done = false;
+  char buffer[64];
+  port.async_read_some(boost::asio::buffer(buffer), CountedReadHandler{ &allocations, &read, &done });
+  port.write_some(boost::asio::buffer("AT\r\n", 4));
+  RunUntil(ioService, done);
+  // The read operation came from the handler's allocator, not from operator new.
+  BOOST_TEST(allocations == 1u);
+  BOOST_TEST(read > 0u);
+
+  std::vector<SerialTrace::Record> records;
+  BOOST_REQUIRE(SerialTrace::Load(path, records));
+  std::remove(path.c_str());
+  BOOST_REQUIRE(records.size() == 2u);
+  BOOST_TEST((records[1].direction == SerialTrace::Direction::RX));
+  BOOST_TEST(records[1].data.size() == read);
+}
@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE shmRing
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "shmRingReader.hpp"
+#include "shmRingWriter.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  constexpr uint32_t kSlotCount = 8;
+
+  std::string RingName(const char* test) {
+    return std::string("rpiclient-test-") + test + "-" + std::to_string(getpid());
+  }
+
+  // Every frame carries its number, starting at 1.
+  bool PublishNumbered(ShmRingWriter& writer, uint64_t number) {
+    return writer.Publish(reinterpret_cast<const char*>(&number), sizeof(number));
+  }
+
+  uint64_t NumberOf(const std::vector<char>& frame) {
+    uint64_t number = 0;
+    std::memcpy(&number, frame.data(), std::min(frame.size(), sizeof(number)));
+    return number;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(LostFramesMatchTheGaps)
+{
+  constexpr uint64_t kFrames = 200000;
+  auto name = RingName("gaps");
+  boost::asio::io_service ioService;
+  ShmRingWriter writer(ioService);
+  BOOST_REQUIRE(writer.Open(name, kSlotCount, sizeof(uint64_t)));
+  ShmRingReader reader;
+  BOOST_REQUIRE(reader.Open(name, true));
+
+  std::atomic<bool> done{ false };
+  std::thread publisher([&]() {
+    for (uint64_t number = 1; number <= kFrames; ++number) {
+      PublishNumbered(writer, number);
+    }
+    done = true;
+  });
+  // A reader this close behind a writer that fast keeps getting its slot overwritten.
+  std::vector<char> frame;
+  uint64_t received = 0;
+  uint64_t misnumbered = 0;
+  for (;;) {
+    auto finished = done.load();
+    auto result = reader.Read(frame);
+    if (result == ShmRingReader::Result::OK) {
+      ++received;
+      if (NumberOf(frame) != received + reader.GetLostFrames()) {
+        ++misnumbered;
+      }
+    } else if (result == ShmRingReader::Result::EMPTY && finished) {
+      break;
+    }
+  }
+  publisher.join();
+
+  BOOST_TEST_MESSAGE(received << " frames received, " << reader.GetLostFrames() << " lost");
+  BOOST_TEST(misnumbered == 0u);
+  BOOST_TEST(received + reader.GetLostFrames() == kFrames);
+}
+
+BOOST_AUTO_TEST_CASE(RestartedWriterIsRemapped)
+{
+  auto name = RingName("restart");
+  boost::asio::io_service ioService;
+  auto writer = std::make_unique<ShmRingWriter>(ioService);
+  BOOST_REQUIRE(writer->Open(name, kSlotCount, sizeof(uint64_t)));
+  ShmRingReader reader;
+  BOOST_REQUIRE(reader.Open(name));
+  BOOST_REQUIRE(PublishNumbered(*writer, 1));
+  std::vector<char> frame;
+  BOOST_TEST((reader.Read(frame) == ShmRingReader::Result::OK));
+
+  writer = std::make_unique<ShmRingWriter>(ioService);
+  BOOST_REQUIRE(writer->Open(name, kSlotCount, sizeof(uint64_t)));
+  for (uint64_t number = 1; number <= 3; ++number) {
+    BOOST_REQUIRE(PublishNumbered(*writer, number));
+  }
+  BOOST_TEST(reader.WaitForData(20ms));
+  BOOST_TEST((reader.Read(frame) == ShmRingReader::Result::RESTARTED));
+  for (uint64_t number = 1; number <= 3; ++number) {
+    BOOST_TEST((reader.Read(frame) == ShmRingReader::Result::OK));
+    BOOST_TEST(NumberOf(frame) == number);
+  }
+  BOOST_TEST((reader.Read(frame) == ShmRingReader::Result::EMPTY));
+  BOOST_TEST(reader.GetLostFrames() == 0u);
+}
@@ -0,0 +1,106 @@
+#define BOOST_TEST_MODULE telemetryCodec
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "telemetryCodec.hpp"
+
+
+namespace
+{
+  const std::string kSample = "{\"humidity\": 45.125, \"temperature\": 21.5, \"pressure\": 1013.25}";
+
+  std::vector<char> ToVector(const std::string& text) {
+    return std::vector<char>(text.begin(), text.end());
+  }
+
+  std::string Encode(TelemetryCodec& codec, const std::string& payload) {
+    std::vector<char> frame;
+    BOOST_REQUIRE(codec.Encode(ToVector(payload), frame));
+    return std::string(frame.begin(), frame.end());
+  }
+
+  // Decodes the chunks in order, every frame that came out.
+  std::vector<std::string> Decode(TelemetryCodec& codec, const std::vector<std::string>& chunks) {
+    std::vector<std::string> frames;
+    for (const auto& chunk : chunks) {
+      BOOST_TEST(codec.Decode(chunk, [&frames](const std::vector<char>& frame) {
+        frames.emplace_back(frame.begin(), frame.end());
+      }));
+    }
+    return frames;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EveryTypeRoundTrips)
+{
+  for (auto type : { TelemetryCodec::Type::NONE, TelemetryCodec::Type::DEFLATE_DICT }) {
+    TelemetryCodec encoder(type);
+    TelemetryCodec decoder(type);
+    auto frame = Encode(encoder, kSample);
+    BOOST_TEST(Decode(decoder, { frame }) == std::vector<std::string>{ kSample });
+    BOOST_TEST(encoder.GetLastBatchStats().outputBytes == frame.size());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(DictionaryShrinksASingleSample)
+{
+  TelemetryCodec codec(TelemetryCodec::Type::DEFLATE_DICT);
+  auto frame = Encode(codec, kSample);
+  // The preset dictionary holds the field names, a lone sample compresses to well under half.
+  BOOST_TEST(frame.size() < kSample.size() / 2);
+  // Big endian length of what follows it.
+  std::size_t length = (static_cast<unsigned char>(frame[0]) << 8) | static_cast<unsigned char>(frame[1]);
+  BOOST_TEST(length == frame.size() - 2);
+}
+
+BOOST_AUTO_TEST_CASE(SeveralFramesInOneChunk)
+{
+  TelemetryCodec encoder(TelemetryCodec::Type::DEFLATE_DICT);
+  TelemetryCodec decoder(TelemetryCodec::Type::DEFLATE_DICT);
+  std::vector<std::string> samples{ kSample, "{\"seq\": 1}", std::string(300, 'x') };
+  std::string chunk;
+  for (const auto& sample : samples) {
+    chunk += Encode(encoder, sample);
+  }
+  BOOST_TEST(Decode(decoder, { chunk }) == samples);
+}
+
+BOOST_AUTO_TEST_CASE(FramesSplitAnywhereAreJoined)
+{
+  TelemetryCodec encoder(TelemetryCodec::Type::DEFLATE_DICT);
+  auto stream = Encode(encoder, kSample) + Encode(encoder, "{\"seq\": 2}");
+  // Position 1 cuts the length prefix of the first frame in half.
+  for (std::size_t cut = 1; cut < stream.size(); ++cut) {
+    TelemetryCodec decoder(TelemetryCodec::Type::DEFLATE_DICT);
+    auto frames = Decode(decoder, { stream.substr(0, cut), stream.substr(cut) });
+    BOOST_TEST(frames == (std::vector<std::string>{ kSample, "{\"seq\": 2}" }), "cut at " << cut);
+  }
+  // One byte at a time, the second frame's length prefix arrives split as well.
+  TelemetryCodec decoder(TelemetryCodec::Type::DEFLATE_DICT);
+  std::vector<std::string> bytes;
+  for (auto c : stream) {
+    bytes.emplace_back(1, c);
+  }
+  BOOST_TEST(Decode(decoder, bytes).size() == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(CorruptFramesAreRejected)
+{
+  TelemetryCodec encoder(TelemetryCodec::Type::DEFLATE_DICT);
+  auto frame = Encode(encoder, kSample);
+  auto ignore = [](const std::vector<char>&) {};
+
+  TelemetryCodec decoder(TelemetryCodec::Type::DEFLATE_DICT);
+  auto garbled = frame;
+  for (std::size_t i = 2; i < garbled.size(); ++i) {
+    garbled[i] = static_cast<char>(0xFF);
+  }
+  BOOST_TEST(!decoder.Decode(garbled, ignore));
+  BOOST_TEST(!decoder.Decode(std::string("\0\0", 2), ignore));
+  // Rejected at once instead of waiting for 60 KB that are never going to come.
+  BOOST_TEST(!decoder.Decode(std::string("\xF0\x00", 2), ignore));
+  // The rejected bytes are gone, the next frame decodes again.
+  BOOST_TEST(Decode(decoder, { frame }) == std::vector<std::string>{ kSample });
+}
@@ -0,0 +1,142 @@
+#define BOOST_TEST_MODULE telemetryPipeline
+#include <boost/test/unit_test.hpp>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "extendedSerialPort.hpp"
+#include "scopedFd.hpp"
+#include "telemetryPipeline.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+  using Clock = std::chrono::steady_clock;
+
+  constexpr std::size_t kBytes = 200;
+  constexpr auto kByteInterval = 5ms;
+  // Allowed growth of the 99th percentile RX latency once the pipeline is saturated.
+  constexpr auto kMaxLatencyGrowth = 10ms;
+
+  // Bytes written to a pty one at a time, timed until the modem io_service sees them.
+  class RxLatency {
+  public:
+    explicit RxLatency(boost::asio::io_service& ioService) : port_(ioService) {
+      int master = -1;
+      int slave = -1;
+      BOOST_REQUIRE(openpty(&master, &slave, nullptr, nullptr, nullptr) == 0);
+      master_.reset(master);
+      termios raw{};
+      tcgetattr(slave, &raw);
+      cfmakeraw(&raw);
+      tcsetattr(slave, TCSANOW, &raw);
+      port_.assign(slave);
+    }
+
+    // Runs ioService until every byte arrived, 99th percentile of their latencies.
+    Clock::duration Measure(boost::asio::io_service& ioService) {
+      received_ = 0;
+      latencies_.clear();
+      ioService.restart();
+      Read();
+      std::thread writer([this]() {
+        for (std::size_t i = 0; i < kBytes; ++i) {
+          std::this_thread::sleep_for(kByteInterval);
+          sentAt_[i] = Clock::now().time_since_epoch().count();
+          char byte = 'x';
+          BOOST_REQUIRE(write(master_.get(), &byte, 1) == 1);
+        }
+      });
+      while (received_ < kBytes) {
+        ioService.run_one_for(1s);
+      }
+      writer.join();
+      std::sort(latencies_.begin(), latencies_.end());
+      return latencies_[latencies_.size() * 99 / 100];
+    }
+
+  private:
+    void Read() {
+      port_.async_read_some(boost::asio::buffer(buffer_), [this](const boost::system::error_code& error, std::size_t size) {
+        auto now = Clock::now().time_since_epoch().count();
+        if (error) {
+          return;
+        }
+        for (std::size_t i = 0; i < size && received_ < kBytes; ++i, ++received_) {
+          latencies_.push_back(Clock::duration(now - sentAt_[received_]));
+        }
+        if (received_ < kBytes) {
+          Read();
+        }
+      });
+    }
+
+    ScopedFd master_;
+    ExtendedSerialPort port_;
+    std::array<char, 64> buffer_;
+    std::array<std::atomic<Clock::rep>, kBytes> sentAt_;
+    std::size_t received_ = 0;
+    std::vector<Clock::duration> latencies_;
+  };
+
+  double ToMilliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SerialRxLatencyStaysFlatUnderSaturatedPipeline)
+{
+  boost::asio::io_service ioService;
+  RxLatency rx(ioService);
+  auto idle = rx.Measure(ioService);
+
+  // A frame per millisecond, bursts of a hundred every drain, far more than the uplink queue takes.
+  TelemetryPipeline::Config config;
+  config.sampleRate = 20000.0;
+  config.sampleInterval = 1ms;
+  config.rawQueueCapacity = 4096;
+  config.queueCapacity = 16;
+  TelemetryPipeline pipeline(ioService, config);
+  std::vector<char> frame;
+  frame.reserve(2 * TelemetryPipeline::kMaxFrameSize);
+  std::size_t frames = 0;
+  BOOST_REQUIRE(pipeline.Start(TelemetryCodec::Type::DEFLATE_DICT, [&]() {
+    while (pipeline.PopFrame(frame)) {
+      ++frames;
+    }
+  }));
+  auto loaded = rx.Measure(ioService);
+  pipeline.Stop();
+
+  BOOST_TEST_MESSAGE("RX latency p99 idle " << ToMilliseconds(idle) << " ms, saturated " << ToMilliseconds(loaded)
+    << " ms, " << frames << " frames, " << pipeline.GetCounters().droppedFrames << " dropped");
+  BOOST_TEST(frames > 0u);
+  // The uplink queue overflowed, so the encoders produced more than the modem thread took.
+  BOOST_TEST(pipeline.GetCounters().droppedFrames > 0u);
+  BOOST_TEST(ToMilliseconds(loaded) <= ToMilliseconds(idle + kMaxLatencyGrowth));
+}
+
+BOOST_AUTO_TEST_CASE(OverflowingDecimationIsRefused)
+{
+  TelemetryPipeline::Config config;
+  config.sampleRate = 100.0;
+  config.decimationOrder = 5;
+  BOOST_TEST(!TelemetryPipeline::CheckDecimation(config));
+  boost::asio::io_service ioService;
+  TelemetryPipeline pipeline(ioService, config);
+  BOOST_TEST(!pipeline.Start(TelemetryCodec::Type::NONE, []() {}));
+
+  config.decimationOrder = 3;
+  BOOST_TEST(TelemetryPipeline::CheckDecimation(config));
+}
@@ -0,0 +1,265 @@
+#define BOOST_TEST_MODULE transportPolicy
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "transportPolicy.hpp"
+
+
+namespace
+{
+  using namespace std::chrono_literals;
+
+  using Events = std::vector<std::string>;
+
+  // Scripted transport, logs what the policy does with it to a list shared by all of them.
+  class FakeTransport : public Transport {
+  public:
+    struct Script {
+      // Results of the connects in order, the last one repeats.
+      std::deque<bool> connects{ true };
+      // Handshake reply, nullopt never answers.
+      OptionalString reply = std::string("OK");
+      std::chrono::milliseconds closeDelay{ 0 };
+      bool reliable = true;
+      // Handshakes lost before one gets a reply.
+      std::size_t lostHandshakes = 0;
+    };
+
+    FakeTransport(boost::asio::io_service& ioService, const char* name, Script script, Events& events) : ioService_(ioService),
+    name_(name),
+    script_(std::move(script)),
+    events_(events) {
+    }
+
+    const char* GetName() const override {
+      return name_;
+    }
+
+    bool IsReliable() const override {
+      return script_.reliable;
+    }
+
+    void Connect(const std::string&, std::size_t, BoolResultCallback cb) override {
+      Log("connect");
+      auto result = script_.connects.front();
+      if (script_.connects.size() > 1) {
+        script_.connects.pop_front();
+      }
+      ioService_.post(std::bind(cb, result));
+    }
+
+    void Send(const std::vector<char>&, BoolResultCallback cb) override {
+      Log("send");
+      ioService_.post(std::bind(cb, true));
+    }
+
+    void Receive(DataCallback cb) override {
+      if (script_.lostHandshakes > 0) {
+        --script_.lostHandshakes;
+        receiveCb_ = std::move(cb);
+        return;
+      }
+      if (script_.reply) {
+        ioService_.post(std::bind(cb, script_.reply));
+        return;
+      }
+      receiveCb_ = std::move(cb);
+    }
+
+    void CancelReceive() override {
+      Log("cancel");
+      receiveCb_ = nullptr;
+    }
+
+    void Close(BoolResultCallback cb) override {
+      Log("close");
+      if (receiveCb_) {
+        ioService_.post(std::bind(std::move(receiveCb_), OptionalString()));
+        receiveCb_ = nullptr;
+      }
+      auto timer = std::make_shared<boost::asio::steady_timer>(ioService_, script_.closeDelay);
+      timer->async_wait([this, timer, cb](const boost::system::error_code&) {
+        Log("closed");
+        cb(true);
+      });
+    }
+
+  private:
+    void Log(const char* event) {
+      events_.push_back(std::string(name_) + " " + event);
+    }
+
+    boost::asio::io_service& ioService_;
+    const char* name_;
+    Script script_;
+    Events& events_;
+    DataCallback receiveCb_;
+  };
+
+  std::size_t Count(const Events& events, const std::string& event) {
+    return std::count(events.begin(), events.end(), event);
+  }
+
+  // Position of the nth (from 0) occurrence of event, events.size() when there isn't one.
+  std::size_t Find(const Events& events, const std::string& event, std::size_t nth = 0) {
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      if (events[i] == event && nth-- == 0) {
+        return i;
+      }
+    }
+    return events.size();
+  }
+
+  struct PolicyFixture {
+    PolicyFixture() {
+      config.handshakeTimeout = 50ms;
+      config.retryInterval = 1h;
+    }
+
+    void Add(const char* name, FakeTransport::Script script) {
+      if (!policy) {
+        policy = std::make_unique<TransportPolicy>(ioService, config);
+      }
+      policy->Add(std::make_unique<FakeTransport>(ioService, name, std::move(script), events));
+    }
+
+    void Start() {
+      policy->Start([this](bool result) { result ? ++ready : ++failed; });
+    }
+
+    void Run(std::chrono::milliseconds duration) {
+      ioService.restart();
+      ioService.run_for(duration);
+    }
+
+    boost::asio::io_service ioService;
+    TransportPolicy::Config config;
+    std::unique_ptr<TransportPolicy> policy;
+    Events events;
+    std::size_t ready = 0;
+    std::size_t failed = 0;
+  };
+}
+
+BOOST_FIXTURE_TEST_CASE(FailsOverToTheNextTransport, PolicyFixture)
+{
+  Add("socket", {});
+  Add("gprs", {});
+  Start();
+  Run(20ms);
+  BOOST_TEST(ready == 1u);
+  BOOST_TEST(policy->GetActiveName() == std::string("socket"));
+
+  BOOST_TEST(policy->FailOver());
+  Run(20ms);
+  BOOST_TEST(ready == 2u);
+  BOOST_TEST(policy->GetActiveName() == std::string("gprs"));
+  BOOST_TEST(Count(events, "socket close") == 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(OnlyTransportReconnects, PolicyFixture)
+{
+  Add("gprs", {});
+  Start();
+  Run(20ms);
+  BOOST_TEST(ready == 1u);
+
+  BOOST_TEST(policy->FailOver());
+  Run(20ms);
+  BOOST_TEST(ready == 2u);
+  BOOST_TEST(Count(events, "gprs connect") == 2u);
+  BOOST_TEST(Find(events, "gprs closed") < Find(events, "gprs connect", 1));
+}
+
+BOOST_FIXTURE_TEST_CASE(RoundOfFailuresWaitsForTheRetry, PolicyFixture)
+{
+  Add("socket", { { false } });
+  Add("gprs", { { false } });
+  Start();
+  Run(100ms);
+  // One attempt each, then the round is over until the retry interval passed.
+  BOOST_TEST(Count(events, "socket connect") == 1u);
+  BOOST_TEST(Count(events, "gprs connect") == 1u);
+  BOOST_TEST(ready == 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(UnansweredHandshakeTimesOut, PolicyFixture)
+{
+  FakeTransport::Script silent;
+  silent.reply = std::experimental::nullopt;
+  Add("socket", silent);
+  Add("gprs", {});
+  Start();
+  Run(200ms);
+  BOOST_TEST(ready == 1u);
+  BOOST_TEST(policy->GetActiveName() == std::string("gprs"));
+  // The read is abandoned before the transport is closed.
+  BOOST_TEST(Find(events, "socket cancel") < Find(events, "socket close"));
+}
+
+BOOST_FIXTURE_TEST_CASE(ReconnectWaitsForTheClose, PolicyFixture)
+{
+  config.retryInterval = 50ms;
+  FakeTransport::Script slowClose{ { false, true } };
+  slowClose.closeDelay = 200ms;
+  Add("gprs", slowClose);
+  Add("socket", { { false } });
+  Start();
+  Run(400ms);
+  // The retry comes while the first close is still running and waits for it.
+  BOOST_TEST(Count(events, "gprs connect") == 2u);
+  BOOST_TEST(Find(events, "gprs closed") < Find(events, "gprs connect", 1));
+  BOOST_TEST(ready == 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(LostHandshakeIsRetransmitted, PolicyFixture)
+{
+  config.handshakeRetransmitInterval = 20ms;
+  FakeTransport::Script udp;
+  udp.reliable = false;
+  udp.lostHandshakes = 2;
+  Add("gprs", udp);
+  Start();
+  Run(200ms);
+  BOOST_TEST(ready == 1u);
+  BOOST_TEST(Count(events, "gprs send") == 3u);
+  BOOST_TEST(Count(events, "gprs cancel") == 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(UnreliableTransportGivesUp, PolicyFixture)
+{
+  config.handshakeRetransmitInterval = 10ms;
+  FakeTransport::Script udp;
+  udp.reliable = false;
+  udp.reply = std::experimental::nullopt;
+  Add("gprs", udp);
+  Start();
+  Run(200ms);
+  BOOST_TEST(failed == 1u);
+  BOOST_TEST(Count(events, "gprs send") == 4u);
+}
+
+BOOST_FIXTURE_TEST_CASE(FramesBehindTheReplyAreReceived, PolicyFixture)
+{
+  config.offeredCodec = TelemetryCodec::Type::DEFLATE_DICT;
+  FakeTransport::Script relaying;
+  relaying.reply = std::string("OK deflate-v1\r\n{\"seq\": 0}");
+  Add("socket", relaying);
+  Start();
+  Run(20ms);
+  BOOST_TEST(ready == 1u);
+  BOOST_TEST((policy->GetCodec() == TelemetryCodec::Type::DEFLATE_DICT));
+  Transport::OptionalString received;
+  policy->Receive([&received](Transport::OptionalString data) { received = data; });
+  Run(20ms);
+  BOOST_TEST((received && received.value() == "{\"seq\": 0}"));
+}
@@ -0,0 +1,92 @@
+#define BOOST_TEST_MODULE udpSession
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "udpSession.hpp"
+
+
+namespace
+{
+  std::string MakeAck(uint32_t cumulativeSeq, uint32_t bitmap) {
+    std::string ack(1, 'A');
+    for (auto value : { cumulativeSeq, bitmap }) {
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        ack.push_back(static_cast<char>((value >> shift) & 0xFF));
+      }
+    }
+    return ack;
+  }
+
+  uint32_t SeqOf(const std::vector<char>& datagram) {
+    uint32_t seq = 0;
+    for (std::size_t i = 1; i < 5; ++i) {
+      seq = (seq << 8) | static_cast<unsigned char>(datagram[i]);
+    }
+    return seq;
+  }
+
+  void Send(UdpSession& session, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      session.Wrap({ 'x' });
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CumulativeAckReleasesDatagrams)
+{
+  UdpSession session;
+  Send(session, 3);
+  BOOST_TEST(session.OnAck(MakeAck(3, 0)));
+  std::vector<char> retransmit;
+  BOOST_TEST(!session.NextRetransmit(retransmit));
+  BOOST_TEST(session.GetCounters().acked == 3u);
+  BOOST_TEST(session.GetCounters().lossDetected == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(GapIsRetransmitted)
+{
+  UdpSession session;
+  Send(session, 3);
+  // 1 and 3 arrived, 2 didn't.
+  BOOST_TEST(session.OnAck(MakeAck(1, 0x2)));
+  std::vector<char> retransmit;
+  BOOST_TEST(session.NextRetransmit(retransmit));
+  BOOST_TEST(SeqOf(retransmit) == 2u);
+  BOOST_TEST(!session.NextRetransmit(retransmit));
+  BOOST_TEST(session.GetCounters().lossDetected == 1u);
+  BOOST_TEST(session.GetCounters().acked == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(RetransmissionInFlightIsNotLostAgain)
+{
+  UdpSession session;
+  Send(session, 3);
+  BOOST_TEST(session.OnAck(MakeAck(1, 0x2)));
+  std::vector<char> retransmit;
+  BOOST_TEST(session.NextRetransmit(retransmit));
+
+  // Acks of datagrams sent before the retransmission can't have seen it.
+  BOOST_TEST(session.OnAck(MakeAck(1, 0x2)));
+  BOOST_TEST(!session.NextRetransmit(retransmit));
+  BOOST_TEST(session.GetCounters().lossDetected == 1u);
+
+  // 4 went out after it and arrived, so the retransmission was lost too.
+  Send(session, 1);
+  BOOST_TEST(session.OnAck(MakeAck(1, 0x6)));
+  BOOST_TEST(session.NextRetransmit(retransmit));
+  BOOST_TEST(SeqOf(retransmit) == 2u);
+  BOOST_TEST(session.GetCounters().lossDetected == 2u);
+  BOOST_TEST(session.GetCounters().retransmitted == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(MalformedAckIsRejected)
+{
+  UdpSession session;
+  Send(session, 1);
+  BOOST_TEST(!session.OnAck("A12"));
+  BOOST_TEST(!session.OnAck(std::string(9, 'B')));
+  BOOST_TEST(session.GetCounters().acked == 0u);
+}
@@ -4,20 +4,26 @@ import json
 from datetime import datetime
 import time
 
+import telemetryCodec
+
 HOST, PORT = "localhost", 9999
 
 # Create a socket (SOCK_STREAM means a TCP socket)
 with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as sock:
     # Connect to server and send data
     sock.connect((HOST, PORT))
-    print(json.dumps({"ClientType": "PUBLISHER"}))
-    sock.sendall(bytes(json.dumps({"ClientType": "PUBLISHER"}), "ascii"))
-    if not str(sock.recv(1024).strip(), "ascii") == "OK":
+    handshake = json.dumps({"ClientType": "PUBLISHER", "Codecs": [telemetryCodec.DEFLATE_DICT]})
+    print(handshake)
+    sock.sendall(bytes(handshake, "ascii"))
+    reply = str(sock.recv(1024).strip(), "ascii")
+    if not reply.startswith("OK"):
         sys.exit("Handshake error")
+    codec = telemetryCodec.negotiated_codec(reply)
+    print("Codec: " + codec)
 
     while True:
         try:
-            sock.sendall(bytes(str(datetime.now()), "ascii"))
+            sock.sendall(telemetryCodec.encode(codec, bytes(str(datetime.now()), "ascii")))
             time.sleep(2)
         except:
             sys.exit("Failed to send data")
@@ -0,0 +1,86 @@
+import json
+import os
+import pty
+import select
+import subprocess
+import sys
+import time
+import tty
+
+# SIM800 on the other end of a pty, enough of it for a TCP publisher session, with a server that
+# accepts the handshake and takes every send. Runs the client with --modem pointing at the pty and
+# stops it once SENDS samples went out, the next CIPSEND is the last thing it sent.
+#
+#   python3 utils/sim800Mock.py SENDS CLIENT ARGS...
+#
+# e.g. regenerating the replay test trace from a build directory:
+#   python3 ../utils/sim800Mock.py 8 tests/fakeSensorClient PUBLISHER --sample-rate 200 --sample-interval 200
+#     --record ../tests/data/publisher.trace
+
+if len(sys.argv) < 3:
+    sys.exit("Usage: sim800Mock.py SENDS CLIENT ARGS...")
+
+sends = int(sys.argv[1])
+master, slave = pty.openpty()
+tty.setraw(slave)
+client = subprocess.Popen(sys.argv[2:] + ["--modem", os.ttyname(slave)])
+
+
+def write(data):
+    os.write(master, bytes(data, "ascii"))
+
+
+def reply(command):
+    echo = command + "\r\r\n"
+    if command == "AT+CPIN?":
+        write(echo + "+CPIN: READY\r\n\r\nOK\r\n")
+    elif command == "AT+CIPSHUT":
+        write(echo + "OK\r\nSHUT OK\r\n")
+    elif command == "AT+CIFSR":
+        write(echo + "10.0.0.2\r\n")
+    elif command.startswith("AT+CIPSTART="):
+        write(echo + "OK\r\n\r\nCONNECT OK\r\n")
+    elif command.startswith("AT+CIPCLOSE"):
+        write(echo + "CLOSE OK\r\n")
+    else:
+        write(echo + "OK\r\n")
+
+
+buffer = b""
+payload = 0
+handshake = True
+sent = 0
+while sent < sends and client.poll() is None:
+    if not select.select([master], [], [], 0.1)[0]:
+        continue
+    buffer += os.read(master, 4096)
+    while sent < sends:
+        if payload > 0:
+            if len(buffer) < payload:
+                break
+            data, buffer = buffer[:payload], buffer[payload:]
+            payload = 0
+            write("\r\nSEND OK\r\n")
+            if handshake:
+                handshake = False
+                codec = json.loads(str(data, "ascii"))["Codecs"][0]
+                write("\r\n+IPD,%d:OK %s" % (len("OK " + codec), codec))
+            else:
+                sent += 1
+                print("Send %d: %d bytes" % (sent, len(data)))
+            continue
+        end = buffer.find(b"\r\n")
+        if end < 0:
+            break
+        command, buffer = str(buffer[:end], "ascii"), buffer[end + 2:]
+        if command.startswith("AT+CIPSEND="):
+            payload = int(command[len("AT+CIPSEND="):])
+            write(command + "\r\r\n> ")
+            continue
+        reply(command)
+
+# Leave the next CIPSEND unanswered, the client is stopped while it waits for the prompt so the
+# recording ends on it.
+time.sleep(1)
+client.terminate()
+client.wait()
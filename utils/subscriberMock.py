@@ -2,17 +2,22 @@ import socket
 import json
 import sys
 
+import telemetryCodec
+
 HOST, PORT = "localhost", 9999
 
 # Create a socket (SOCK_STREAM means a TCP socket)
 with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as sock:
     # Connect to server and send data
     sock.connect((HOST, PORT))
-    sock.sendall(bytes(json.dumps({"ClientType": "SUBSCRIBER"}), "ascii"))
-    if not str(sock.recv(1024).strip(), "ascii") == "OK":
+    sock.sendall(bytes(json.dumps({"ClientType": "SUBSCRIBER", "Codecs": [telemetryCodec.DEFLATE_DICT]}), "ascii"))
+    reply = str(sock.recv(1024).strip(), "ascii")
+    if not reply.startswith("OK"):
         sys.exit("Handshake error")
+    decoder = telemetryCodec.Decoder(telemetryCodec.negotiated_codec(reply))
     while True:
         data = sock.recv(1024)
         if len(data) == 0:
             break
-        print(str(data, "ascii"))
+        for frame in decoder.feed(data):
+            print(str(frame, "ascii"))
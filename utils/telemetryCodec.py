@@ -0,0 +1,52 @@
+import struct
+import zlib
+
+NONE = "none"
+DEFLATE_DICT = "deflate-v1"
+
+# Must be kept byte for byte in sync with kTelemetryDictionary in src/telemetryCodec.cpp
+TELEMETRY_DICTIONARY = (
+    b'{"ClientType":"SUBSCRIBER"}{"ClientType":"PUBLISHER"}'
+    b'0.1 0.2 0.3 0.4 0.5 0.6 0.7 0.8 0.9 1000.1 1010.2 1020.3 990.4 1005.5 '
+    b'[{"humidity": 35.1, "temperature": 18.2, "pressure": 1001.3}, '
+    b'{"humidity": 55.7, "temperature": 24.9, "pressure": 1012.6}]'
+    b'{"humidity": 45.0625, "temperature": 21.35, "pressure": 1013.25}'
+)
+
+FRAME_HEADER = struct.Struct(">H")
+
+
+def negotiated_codec(handshake_reply):
+    reply = handshake_reply.split()
+    if len(reply) > 1 and reply[0] == "OK" and reply[1] == DEFLATE_DICT:
+        return DEFLATE_DICT
+    return NONE
+
+
+def encode(codec, payload):
+    if codec == NONE:
+        return payload
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15, 8, zlib.Z_DEFAULT_STRATEGY, TELEMETRY_DICTIONARY)
+    frame = compressor.compress(payload) + compressor.flush()
+    return FRAME_HEADER.pack(len(frame)) + frame
+
+
+class Decoder:
+    def __init__(self, codec):
+        self.codec = codec
+        self.pending = b""
+
+    def feed(self, chunk):
+        if self.codec == NONE:
+            return [chunk]
+        self.pending += chunk
+        frames = []
+        while len(self.pending) >= FRAME_HEADER.size:
+            (size,) = FRAME_HEADER.unpack_from(self.pending)
+            if len(self.pending) - FRAME_HEADER.size < size:
+                break
+            frame = self.pending[FRAME_HEADER.size:FRAME_HEADER.size + size]
+            self.pending = self.pending[FRAME_HEADER.size + size:]
+            decompressor = zlib.decompressobj(-15, TELEMETRY_DICTIONARY)
+            frames.append(decompressor.decompress(frame) + decompressor.flush())
+        return frames